@@ -0,0 +1,257 @@
+/**
+ * Microbenchmark of the computation of the systematics envelope, as done by
+ * TH1Plotter::computeSystematics: the previous implementation (one virtual call per bin
+ * and variation, scalar envelope, errors stored in a map keyed by systematic name)
+ * against SystematicsEnvelope, indexed by systematic id.
+ *
+ * Usage: envelope [bins] [systematics] [processes] [iterations]
+ */
+
+#include <envelope.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace plotIt;
+
+namespace {
+
+    // Stand-in for TH1: bin contents are only reachable through a virtual call
+    class Histogram {
+        public:
+            explicit Histogram(std::size_t n_bins): m_contents(n_bins + 2) {}
+            virtual ~Histogram() = default;
+
+            virtual double GetBinContent(int bin) const {
+                return m_contents[bin];
+            }
+
+            std::size_t GetNbinsX() const {
+                return m_contents.size() - 2;
+            }
+
+            const double* GetArray() const {
+                return m_contents.data();
+            }
+
+            std::vector<double> m_contents;
+    };
+
+    struct Variation {
+        std::string name;
+        std::size_t id;
+        std::unique_ptr<Histogram> up;
+        std::unique_ptr<Histogram> down;
+    };
+
+    struct Process {
+        std::unique_ptr<Histogram> nominal;
+        std::vector<Variation> variations;
+    };
+
+    struct Result {
+        std::vector<float> error;
+        std::vector<float> error_up;
+        std::vector<float> error_down;
+        double totals = 0;
+    };
+
+    std::vector<Process> generate(std::size_t n_bins, std::size_t n_systematics, std::size_t n_processes) {
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<double> content(10, 1000);
+        std::normal_distribution<double> shift(0, 0.05);
+
+        std::vector<Process> processes(n_processes);
+        for (auto& process: processes) {
+            process.nominal.reset(new Histogram(n_bins));
+            for (auto& c: process.nominal->m_contents)
+                c = content(generator);
+
+            for (std::size_t s = 0; s < n_systematics; s++) {
+                Variation variation;
+                variation.name = "syst_" + std::to_string(s);
+                variation.id = s;
+                variation.up.reset(new Histogram(n_bins));
+                variation.down.reset(new Histogram(n_bins));
+
+                for (std::size_t i = 0; i < n_bins + 2; i++) {
+                    double nominal = process.nominal->m_contents[i];
+                    variation.up->m_contents[i] = nominal * (1 + shift(generator));
+                    variation.down->m_contents[i] = nominal * (1 + shift(generator));
+                }
+
+                process.variations.push_back(std::move(variation));
+            }
+        }
+
+        return processes;
+    }
+
+    // Previous implementation of TH1Plotter::computeSystematics
+    Result reference(const std::vector<Process>& processes, std::size_t n_bins) {
+        std::map<std::string, std::vector<float>> combined_systematics_map;
+        std::map<std::string, std::vector<float>> combined_systematics_map_up;
+        std::map<std::string, std::vector<float>> combined_systematics_map_dn;
+
+        Result result;
+
+        for (const auto& process: processes) {
+            for (const auto& variation: process.variations) {
+                std::vector<float>& combined_systematics = combined_systematics_map[variation.name];
+                std::vector<float>& combined_systematics_up = combined_systematics_map_up[variation.name];
+                std::vector<float>& combined_systematics_dn = combined_systematics_map_dn[variation.name];
+                combined_systematics.resize(n_bins, 0.);
+                combined_systematics_up.resize(n_bins, 0.);
+                combined_systematics_dn.resize(n_bins, 0.);
+
+                float total_syst_error = 0;
+                for (std::size_t i = 1; i <= n_bins; i++) {
+                    float syst_error_up = 0.;
+                    float syst_error_dn = 0.;
+                    double nominal = process.nominal->GetBinContent(i);
+                    float temp_syst_error_up = variation.up->GetBinContent(i) - nominal;
+                    float temp_syst_error_dn = variation.down->GetBinContent(i) - nominal;
+
+                    if (temp_syst_error_up * temp_syst_error_dn <= 0) {
+                        if (temp_syst_error_up >= 0 and temp_syst_error_dn < 0) {
+                            syst_error_up = temp_syst_error_up;
+                            syst_error_dn = temp_syst_error_dn;
+                        } else {
+                            syst_error_up = temp_syst_error_dn;
+                            syst_error_dn = temp_syst_error_up;
+                        }
+                    } else {
+                        if (temp_syst_error_up > 0) {
+                            syst_error_up = std::max(temp_syst_error_up, temp_syst_error_dn);
+                            syst_error_dn = 0.0;
+                        } else {
+                            syst_error_up = 0.0;
+                            syst_error_dn = std::max(temp_syst_error_up, temp_syst_error_dn);
+                        }
+                    }
+                    float syst_error = std::max(syst_error_up, syst_error_dn);
+
+                    total_syst_error += syst_error;
+
+                    combined_systematics[i - 1] += syst_error;
+                    combined_systematics_up[i - 1] += syst_error_up;
+                    combined_systematics_dn[i - 1] += syst_error_dn;
+                }
+
+                result.totals += total_syst_error;
+            }
+        }
+
+        result.error.resize(n_bins, 0.);
+        result.error_up.resize(n_bins, 0.);
+        result.error_down.resize(n_bins, 0.);
+
+        for (auto& combined_systematics: combined_systematics_map) {
+            for (std::size_t i = 0; i < n_bins; i++)
+                result.error[i] = std::sqrt(result.error[i] * result.error[i] + combined_systematics.second[i] * combined_systematics.second[i]);
+        }
+        for (auto& combined_systematics: combined_systematics_map_up) {
+            for (std::size_t i = 0; i < n_bins; i++)
+                result.error_up[i] = std::sqrt(result.error_up[i] * result.error_up[i] + combined_systematics.second[i] * combined_systematics.second[i]);
+        }
+        for (auto& combined_systematics: combined_systematics_map_dn) {
+            for (std::size_t i = 0; i < n_bins; i++)
+                result.error_down[i] = std::sqrt(result.error_down[i] * result.error_down[i] + combined_systematics.second[i] * combined_systematics.second[i]);
+        }
+
+        return result;
+    }
+
+    // Current implementation, with SystematicsEnvelope
+    Result vectorized(const std::vector<Process>& processes, std::size_t n_bins, std::size_t n_systematics) {
+        SystematicsEnvelope envelope(n_bins, n_systematics);
+
+        std::vector<double> nominal(n_bins + 2);
+        std::vector<double> up(n_bins + 2);
+        std::vector<double> down(n_bins + 2);
+
+        Result result;
+
+        for (const auto& process: processes) {
+            for (const auto& variation: process.variations) {
+                std::copy(process.nominal->GetArray(), process.nominal->GetArray() + n_bins + 2, nominal.begin());
+                std::copy(variation.up->GetArray(), variation.up->GetArray() + n_bins + 2, up.begin());
+                std::copy(variation.down->GetArray(), variation.down->GetArray() + n_bins + 2, down.begin());
+
+                result.totals += envelope.add(variation.id, nominal.data() + 1, up.data() + 1, down.data() + 1, true);
+            }
+        }
+
+        result.error.resize(n_bins, 0.);
+        result.error_up.resize(n_bins, 0.);
+        result.error_down.resize(n_bins, 0.);
+        envelope.addSquares(result.error.data(), result.error_up.data(), result.error_down.data());
+
+        for (std::size_t i = 0; i < n_bins; i++) {
+            result.error[i] = std::sqrt(result.error[i]);
+            result.error_up[i] = std::sqrt(result.error_up[i]);
+            result.error_down[i] = std::sqrt(result.error_down[i]);
+        }
+
+        return result;
+    }
+
+    double max_relative_difference(const std::vector<float>& a, const std::vector<float>& b) {
+        double difference = 0;
+        for (std::size_t i = 0; i < a.size(); i++) {
+            double scale = std::max(std::abs(a[i]), std::abs(b[i]));
+            if (scale > 0)
+                difference = std::max(difference, std::abs(a[i] - b[i]) / scale);
+        }
+
+        return difference;
+    }
+
+    template <typename F>
+    double time(F f, std::size_t iterations, Result& result) {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; i++)
+            result = f();
+        auto end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::size_t n_bins = (argc > 1) ? std::atoi(argv[1]) : 100;
+    std::size_t n_systematics = (argc > 2) ? std::atoi(argv[2]) : 80;
+    std::size_t n_processes = (argc > 3) ? std::atoi(argv[3]) : 50;
+    std::size_t iterations = (argc > 4) ? std::atoi(argv[4]) : 20;
+
+    auto processes = generate(n_bins, n_systematics, n_processes);
+
+    Result reference_result;
+    Result vectorized_result;
+
+    double reference_time = time([&]() { return reference(processes, n_bins); }, iterations, reference_result);
+    double vectorized_time = time([&]() { return vectorized(processes, n_bins, n_systematics); }, iterations, vectorized_result);
+
+    std::cout << n_bins << " bins, " << n_systematics << " systematics, " << n_processes << " processes" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  reference:  " << reference_time << " ms" << std::endl;
+    std::cout << "  vectorized: " << vectorized_time << " ms (x" << std::setprecision(2) << reference_time / vectorized_time << ")" << std::endl;
+
+    double difference = std::max({
+            max_relative_difference(reference_result.error, vectorized_result.error),
+            max_relative_difference(reference_result.error_up, vectorized_result.error_up),
+            max_relative_difference(reference_result.error_down, vectorized_result.error_down)
+    });
+
+    std::cout << std::scientific << "  max relative difference: " << difference << std::endl;
+
+    return (difference < 1e-4 && std::abs(reference_result.totals - vectorized_result.totals) <= 1e-4 * std::abs(reference_result.totals)) ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+/**
+ * Generator of a synthetic workload for plotIt: one ROOT file per process, plus one for
+ * the data, each holding the same histograms, and the configuration file plotting them.
+ *
+ * Every histogram of the simulated processes has an up and a down variation for each
+ * shape systematic, stored next to it as `<histogram>__<systematic>up` and `...down`.
+ * The content is pseudo-random, but always the same for the same arguments.
+ *
+ * Usage: generate <output folder> [processes] [histograms] [systematics] [bins]
+ *
+ * Then: plotIt -i <output folder> -o <plots folder> <output folder>/config.yml
+ */
+
+#include <TFile.h>
+#include <TH1F.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    // Falling spectrum, with some noise, normalised to about `events` events
+    std::vector<double> spectrum(std::size_t n_bins, double events, std::mt19937& generator) {
+        std::normal_distribution<double> noise(1, 0.05);
+
+        std::vector<double> contents(n_bins);
+        double sum = 0;
+        for (std::size_t i = 0; i < n_bins; i++) {
+            contents[i] = std::exp(-3. * i / n_bins) * noise(generator);
+            sum += contents[i];
+        }
+
+        for (auto& content: contents)
+            content *= events / sum;
+
+        return contents;
+    }
+
+    void write(const std::string& name, const std::vector<double>& contents) {
+        TH1F h(name.c_str(), "", contents.size(), 0, 100);
+        for (std::size_t i = 0; i < contents.size(); i++) {
+            h.SetBinContent(i + 1, contents[i]);
+            h.SetBinError(i + 1, std::sqrt(contents[i]));
+        }
+
+        h.Write();
+    }
+
+    std::string histogram_name(std::size_t histogram) {
+        return "histo_" + std::to_string(histogram);
+    }
+
+    std::string systematic_name(std::size_t systematic) {
+        return "syst" + std::to_string(systematic);
+    }
+}
+
+int main(int argc, char** argv) {
+
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output folder> [processes] [histograms] [systematics] [bins]" << std::endl;
+        return 1;
+    }
+
+    std::string output = argv[1];
+    std::size_t n_processes = (argc > 2) ? std::atoi(argv[2]) : 10;
+    std::size_t n_histograms = (argc > 3) ? std::atoi(argv[3]) : 100;
+    std::size_t n_systematics = (argc > 4) ? std::atoi(argv[4]) : 20;
+    std::size_t n_bins = (argc > 5) ? std::atoi(argv[5]) : 50;
+
+    std::mt19937 generator(42);
+    std::normal_distribution<double> shift(0, 0.05);
+
+    std::vector<std::vector<double>> data(n_histograms, std::vector<double>(n_bins, 0.));
+
+    for (std::size_t process = 0; process < n_processes; process++) {
+        std::string path = output + "/process_" + std::to_string(process) + ".root";
+        std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "recreate"));
+        if (! file) {
+            std::cerr << "Error: cannot create '" << path << "'" << std::endl;
+            return 1;
+        }
+
+        for (std::size_t histogram = 0; histogram < n_histograms; histogram++) {
+            auto nominal = spectrum(n_bins, 1000. * (process + 1), generator);
+            write(histogram_name(histogram), nominal);
+
+            for (std::size_t i = 0; i < n_bins; i++)
+                data[histogram][i] += nominal[i];
+
+            for (std::size_t systematic = 0; systematic < n_systematics; systematic++) {
+                std::vector<double> up(n_bins);
+                std::vector<double> down(n_bins);
+                for (std::size_t i = 0; i < n_bins; i++) {
+                    double variation = shift(generator);
+                    up[i] = nominal[i] * (1 + variation);
+                    down[i] = nominal[i] * (1 - variation);
+                }
+
+                std::string name = histogram_name(histogram) + "__" + systematic_name(systematic);
+                write(name + "up", up);
+                write(name + "down", down);
+            }
+        }
+
+        file->Close();
+    }
+
+    {
+        std::string path = output + "/data.root";
+        std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "recreate"));
+        if (! file) {
+            std::cerr << "Error: cannot create '" << path << "'" << std::endl;
+            return 1;
+        }
+
+        for (std::size_t histogram = 0; histogram < n_histograms; histogram++) {
+            for (auto& content: data[histogram])
+                content = std::poisson_distribution<int>(content)(generator);
+
+            write(histogram_name(histogram), data[histogram]);
+        }
+
+        file->Close();
+    }
+
+    std::ofstream config(output + "/config.yml");
+
+    config << "configuration:" << std::endl;
+    config << "  width: 800" << std::endl;
+    config << "  height: 800" << std::endl;
+    config << "  luminosity: 1" << std::endl;
+    config << "  luminosity-label: '%1$.0f pb^{-1}'" << std::endl;
+    config << "  experiment: 'plotIt'" << std::endl;
+    config << "  extra-label: 'Benchmark'" << std::endl;
+    config << "  root: ''" << std::endl;
+    config << std::endl;
+
+    config << "files:" << std::endl;
+    config << "  'data.root':" << std::endl;
+    config << "    type: data" << std::endl;
+    config << "    pretty-name: 'Data'" << std::endl;
+    for (std::size_t process = 0; process < n_processes; process++) {
+        config << "  'process_" << process << ".root':" << std::endl;
+        config << "    type: mc" << std::endl;
+        config << "    pretty-name: 'Process " << process << "'" << std::endl;
+        config << "    legend: 'Process " << process << "'" << std::endl;
+        config << "    cross-section: 1" << std::endl;
+        config << "    generated-events: 1" << std::endl;
+        config << "    fill-color: " << (2 + process % 8) << std::endl;
+        config << "    order: " << process << std::endl;
+    }
+    config << std::endl;
+
+    if (n_systematics > 0) {
+        config << "systematics:" << std::endl;
+        for (std::size_t systematic = 0; systematic < n_systematics; systematic++)
+            config << "  - " << systematic_name(systematic) << std::endl;
+        config << std::endl;
+    }
+
+    config << "plots:" << std::endl;
+    config << "  'histo_*':" << std::endl;
+    config << "    x-axis: 'Observable'" << std::endl;
+    config << "    y-axis: 'Events'" << std::endl;
+    config << "    save-extensions: ['png']" << std::endl;
+    config << "    show-ratio: true" << std::endl;
+    config << "    for-yields: true" << std::endl;
+    config << "    yields-title: 'All'" << std::endl;
+
+    std::cout << "Generated " << n_processes << " processes, " << n_histograms << " histograms, "
+        << n_systematics << " systematics and " << n_bins << " bins in '" << output << "'" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#!/bin/bash
+
+# Time plotIt on a synthetic workload, and print the time spent in each phase as JSON.
+#
+# Usage: bench/run.sh [processes] [histograms] [systematics] [bins] [-- plotIt options]
+#
+# Build first with `make plotIt bench`. The inputs are generated in a temporary folder,
+# removed afterwards. Extra options, e.g. `-- -j 4 --async-write`, are passed to plotIt.
+
+set -e
+
+# Quote a value as a JSON string
+json_string() {
+    local value="$1"
+    value="${value//\\/\\\\}"
+    value="${value//\"/\\\"}"
+    value="${value//$'\t'/\\t}"
+    value="${value//$'\n'/\\n}"
+    value="${value//$'\r'/\\r}"
+    printf '"%s"' "$value"
+}
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+ROOT="$(dirname "$HERE")"
+
+PROCESSES=10
+HISTOGRAMS=100
+SYSTEMATICS=20
+BINS=50
+
+for VARIABLE in PROCESSES HISTOGRAMS SYSTEMATICS BINS; do
+    if [ $# -eq 0 ] || [ "$1" == "--" ]; then
+        break
+    fi
+    eval "$VARIABLE=$1"
+    shift
+done
+
+if [ "$1" == "--" ]; then
+    shift
+fi
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+mkdir -p "$WORK/inputs" "$WORK/plots"
+
+"$HERE/generate" "$WORK/inputs" $PROCESSES $HISTOGRAMS $SYSTEMATICS $BINS >&2
+"$ROOT/plotIt" -f -i "$WORK/inputs" -o "$WORK/plots" --timing-report "$WORK/timing.json" "$@" "$WORK/inputs/config.yml" >&2
+
+# The plotIt options, as a JSON array of strings
+OPTIONS=""
+for OPTION in "$@"; do
+    if [ -n "$OPTIONS" ]; then
+        OPTIONS="$OPTIONS, "
+    fi
+    OPTIONS="$OPTIONS$(json_string "$OPTION")"
+done
+
+echo "{"
+echo "  \"workload\": {\"processes\": $PROCESSES, \"histograms\": $HISTOGRAMS, \"systematics\": $SYSTEMATICS, \"bins\": $BINS, \"options\": [$OPTIONS]},"
+echo "  \"timing\": $(sed -e '2,$s/^/  /' "$WORK/timing.json")"
+echo "}"
@@ -2,6 +2,9 @@
 
 #include <plotter.h>
 
+#include <limits>
+#include <map>
+
 namespace plotIt {
     class TH1Plotter: public plotter {
         public:
@@ -14,10 +17,38 @@ namespace plotIt {
                 std::shared_ptr<TGraphAsymmErrors> stat_and_syst_asym;
                 std::shared_ptr<TH1> syst_siglike_up;
                 std::shared_ptr<TH1> syst_siglike_dn;
+
+                // Merged histograms of the legend groups, added to the stack
+                std::vector<std::shared_ptr<TH1>> group_histograms;
             };
 
             using Stacks = std::vector<std::pair<int64_t, Stack>>;
 
+            // Bin contents of the nominal histogram of each file, including underflow and overflow
+            using NominalContents = std::map<const File*, std::vector<double>>;
+
+            /**
+             * Histograms of a plot once rescaled and combined, ready to be drawn. They do not
+             * depend on the axis scales, and are shared by the log-x / log-y variants of the plot
+             */
+            struct Prepared {
+                std::string uid;
+                const TObject* object = nullptr;
+
+                Summary summary;
+
+                std::shared_ptr<TH1> h_data;
+                std::string data_drawing_options;
+                double h_data_integral = 1.0;
+
+                Stacks mc_stacks;
+                bool no_systematics = false;
+
+                // Signal histograms, with their drawing options
+                std::vector<std::pair<TH1*, std::string>> signals;
+                float signal_maximum = std::numeric_limits<float>::lowest();
+            };
+
             TH1Plotter(plotIt& plotIt):
                 plotter(plotIt) {
                 }
@@ -25,6 +56,10 @@ namespace plotIt {
             virtual boost::optional<Summary> plot(TCanvas& c, Plot& plot);
             virtual bool supports(TObject& object);
 
+            virtual void reset() override {
+                m_prepared.reset();
+            }
+
         private:
             void setHistogramStyle(const File& file);
             void addOverflow(TH1* h, Type type, const Plot& plot);
@@ -33,7 +68,12 @@ namespace plotIt {
             Stack buildStack(int64_t index, bool sortByYields);
             Stacks buildStacks(bool sortByYields);
 
-            void computeSystematics(int64_t index, Stack& stack, Summary& summary);
-            void computeSystematics(Stacks& stacks, Summary& summary);
+            void computeSystematics(int64_t index, Stack& stack, Summary& summary, const NominalContents& nominal_contents);
+            void computeSystematics(Stacks& stacks, Summary& summary, const NominalContents& nominal_contents);
+
+            std::shared_ptr<Prepared> prepare(Plot& plot);
+
+            // Last prepared plot, reused by its variants
+            std::shared_ptr<Prepared> m_prepared;
     };
 }
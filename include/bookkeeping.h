@@ -0,0 +1,92 @@
+#pragma once
+
+#include <ipc.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+class TCanvas;
+class TDirectory;
+class TFile;
+class TObject;
+
+namespace plotIt {
+
+    /**
+     * Writer of the book-keeping file.
+     *
+     * The file is owned by a separate process: objects are serialized as soon as they are
+     * drawn, buffered, and sent to this process in batches. Compressing and writing the
+     * objects does not slow down the plotting process anymore.
+     *
+     * Either whole canvases are stored, or only the objects drawn on them (histograms,
+     * stacks and graphs), in a folder named after the canvas.
+     */
+    class BookKeeper {
+        public:
+            enum Mode {
+                CANVAS,
+                PRIMITIVES
+            };
+
+            BookKeeper() = default;
+            ~BookKeeper();
+
+            BookKeeper(const BookKeeper&) = delete;
+            BookKeeper& operator=(const BookKeeper&) = delete;
+
+            /**
+             * Open the book-keeping file. `option` is passed to TFile::Open
+             */
+            bool open(const std::string& path, const std::string& option, Mode mode);
+
+            bool isOpen() const {
+                return m_process.running() || m_file;
+            }
+
+            /**
+             * Store a canvas, or its primitives, in the folder `folder` of the file
+             */
+            void add(TCanvas& canvas, const std::string& folder);
+
+            /**
+             * Write everything still buffered and close the file. Return false if anything failed.
+             */
+            bool close();
+
+            // Objects buffered before being sent to the writer process
+            static constexpr std::size_t batch_size = 16;
+
+        private:
+            struct Entry {
+                std::string folder;
+                std::string name;
+                std::vector<char> data;
+            };
+
+            void add(const TObject& object, const std::string& folder, const std::string& name);
+            bool flush();
+
+            void run(int fd);
+            void write(const std::string& folder, const std::string& name, TObject* object);
+
+            Mode m_mode = CANVAS;
+
+            // Writer process
+            HelperProcess m_process;
+            std::vector<Entry> m_pending;
+            bool m_failed = false;
+
+            // Owned by the writer process, or by this one if it cannot be started
+            std::shared_ptr<TFile> m_file;
+
+            // Look in the cache if we have this folder. This avoid querying the file each time we save a plot
+            std::map<std::string, TDirectory*> m_folders;
+
+            // Folders filled with primitives during this run
+            std::set<std::string> m_primitives_folders;
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <types.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+class TFile;
+class TObject;
+
+namespace plotIt {
+
+    /**
+     * On-disk cache of the histograms read from the input files, enabled with '--cache-dir'.
+     *
+     * Each input file has its own folder, named after a hash of its path, modification time
+     * and size: a modified file simply gets a new folder. Each object is stored in its own
+     * entry, named after a hash of the object name, holding a fixed header followed by the
+     * object as serialized by ROOT, so that it is read back exactly as it is in the file,
+     * with its axes, labels and styles. Entries are read through mmap, without opening the
+     * input file. Objects missing from a file are stored too, as empty entries.
+     *
+     * Trees are never cached.
+     */
+    class HistogramCache {
+        public:
+            static HistogramCache& get() {
+                static HistogramCache s_instance;
+
+                return s_instance;
+            }
+
+            bool enabled() const;
+
+            /**
+             * Look for the object `name` of the file `path`. Return false if the cache knows
+             * nothing about it. Otherwise, `object` is the cached object, owned by the caller,
+             * or is null if the file has no such object.
+             */
+            bool load(const std::string& path, const std::string& name, std::shared_ptr<TObject>& object);
+
+            /**
+             * Size on disk of the entry for the object `name` of the file `path`, if any
+             */
+            bool size(const std::string& path, const std::string& name, double& size);
+
+            /**
+             * Store the object `name` of the file `path`. A null object records that the file
+             * has no such object.
+             */
+            void store(const std::string& path, const std::string& name, const TObject* object);
+
+            HistogramCache(HistogramCache const&) = delete;
+            HistogramCache(HistogramCache&&) = delete;
+            HistogramCache& operator=(HistogramCache const&) = delete;
+            HistogramCache& operator=(HistogramCache &&) = delete;
+
+        protected:
+            HistogramCache() = default;
+
+        private:
+            std::string entryPath(const std::string& path, const std::string& name);
+
+            // Cache folder of each input file, empty if the file cannot be cached
+            std::map<std::string, std::string> m_folders;
+    };
+
+    /**
+     * Read an object of a ROOT file, through the histogram cache if it's enabled. The file
+     * is opened, and its keys indexed, only if the object is not in the cache.
+     *
+     * Return false, once the error is reported, if the file cannot be opened. Otherwise,
+     * `object` is owned by the caller, and is null if there is no such object.
+     */
+    bool getCachedObject(const std::string& path, std::shared_ptr<TFile>& handle, std::shared_ptr<KeyIndex>& keys, const std::string& name, std::shared_ptr<TObject>& object);
+}
@@ -22,8 +22,14 @@ class CommandLineCfg {
         bool allSig = false;
         bool noSig = false;
         bool binned = false;
+        bool force = false;
+        bool async_write = false;
+        unsigned int jobs = 1;
+        unsigned int threads = 1;
+        unsigned int max_memory = 2048; // MB
         std::string selectSig = "";
         std::string era = "";
+        std::string cache_dir = "";
 
     private:
         CommandLineCfg() = default;
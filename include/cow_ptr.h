@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+
+namespace plotIt {
+
+    /**
+     * Shared pointer to a ROOT object, with copy-on-write semantic: copies of the pointer
+     * share the same object until one of them asks for write access, at which point the
+     * object is cloned if it's still shared.
+     */
+    template <typename T>
+    class cow_ptr {
+        public:
+            cow_ptr() = default;
+            cow_ptr(T* object): m_object(object) {}
+            cow_ptr(const std::shared_ptr<T>& object): m_object(object) {}
+
+            /**
+             * Read-only access. The object must not be modified through this pointer
+             */
+            T* get() const {
+                return m_object.get();
+            }
+
+            /**
+             * Write access. Clone the object first if it's shared
+             */
+            T* write() {
+                if (m_object && m_object.use_count() > 1)
+                    m_object.reset(static_cast<T*>(m_object->Clone()));
+
+                return m_object.get();
+            }
+
+            void reset(T* object = nullptr) {
+                m_object.reset(object);
+            }
+
+            explicit operator bool() const {
+                return static_cast<bool>(m_object);
+            }
+
+        private:
+            std::shared_ptr<T> m_object;
+    };
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace plotIt {
+
+    /**
+     * Error on each side of the nominal, for a single bin.
+     *
+     * For a double-sided variation, the positive shift is the up error and the negative one
+     * the down error. For a one-sided variation, only the largest shift is kept, on its side.
+     * Written without branches so that loops over bins are vectorized.
+     */
+    inline void envelopeErrors(float shift_up, float shift_down, float& error_up, float& error_down) {
+        bool double_sided = shift_up * shift_down <= 0;
+        bool ordered = (shift_up >= 0) & (shift_down < 0);
+        bool positive = shift_up > 0;
+        float largest = std::max(shift_up, shift_down);
+
+        float double_sided_up = ordered ? shift_up : shift_down;
+        float double_sided_down = ordered ? shift_down : shift_up;
+        float one_sided_up = positive ? largest : 0.f;
+        float one_sided_down = positive ? 0.f : largest;
+
+        error_up = double_sided ? double_sided_up : one_sided_up;
+        error_down = double_sided ? double_sided_down : one_sided_down;
+    }
+
+    /**
+     * Add `values` to `result`, bin by bin
+     */
+    inline void add(const float* values, std::size_t n_bins, float* result) {
+        for (std::size_t i = 0; i < n_bins; i++)
+            result[i] += values[i];
+    }
+
+    /**
+     * Add the square of `values` to `result`, bin by bin
+     */
+    inline void addSquare(const float* values, std::size_t n_bins, float* result) {
+        for (std::size_t i = 0; i < n_bins; i++)
+            result[i] += values[i] * values[i];
+    }
+
+    /**
+     * Add `shape - nominal` to `result`, bin by bin
+     */
+    inline void addDifference(const double* nominal, const double* shape, std::size_t n_bins, float* result) {
+        for (std::size_t i = 0; i < n_bins; i++)
+            result[i] += static_cast<float>(shape[i] - nominal[i]);
+    }
+
+    /**
+     * Uncertainty envelope of a set of systematics, bin by bin.
+     *
+     * Each systematic owns one row of bins, indexed by its id: the errors are dense
+     * [systematic x bin] matrices. They are stored as a structure of arrays: the symmetric,
+     * up and down errors of a systematic are each contiguous, so that all the loops over bins
+     * are vectorized.
+     */
+    class SystematicsEnvelope {
+        public:
+            SystematicsEnvelope(std::size_t n_bins, std::size_t n_rows):
+                m_n_bins(n_bins), m_rows(n_rows),
+                m_error(n_rows * n_bins, 0.f), m_error_up(n_rows * n_bins, 0.f), m_error_down(n_rows * n_bins, 0.f),
+                m_errors(n_bins), m_errors_up(n_bins), m_errors_down(n_bins) {
+
+            }
+
+            std::size_t bins() const {
+                return m_n_bins;
+            }
+
+            std::size_t rows() const {
+                return m_rows;
+            }
+
+            const float* error(std::size_t row) const {
+                return m_error.data() + row * m_n_bins;
+            }
+
+            const float* errorUp(std::size_t row) const {
+                return m_error_up.data() + row * m_n_bins;
+            }
+
+            const float* errorDown(std::size_t row) const {
+                return m_error_down.data() + row * m_n_bins;
+            }
+
+            /**
+             * Compute the errors of one variation of the nominal shape, and return their sum
+             * over the bins. They are added to the row `row` only if `accumulate` is true.
+             */
+            float add(std::size_t row, const double* nominal, const double* up, const double* down, bool accumulate) {
+                float* errors = m_errors.data();
+                float* errors_up = m_errors_up.data();
+                float* errors_down = m_errors_down.data();
+
+                for (std::size_t i = 0; i < m_n_bins; i++) {
+                    envelopeErrors(static_cast<float>(up[i] - nominal[i]), static_cast<float>(down[i] - nominal[i]), errors_up[i], errors_down[i]);
+                    errors[i] = std::max(errors_up[i], errors_down[i]);
+                }
+
+                if (accumulate) {
+                    ::plotIt::add(errors, m_n_bins, m_error.data() + row * m_n_bins);
+                    ::plotIt::add(errors_up, m_n_bins, m_error_up.data() + row * m_n_bins);
+                    ::plotIt::add(errors_down, m_n_bins, m_error_down.data() + row * m_n_bins);
+                }
+
+                // Summed in order, outside of the vectorized loops
+                float total = 0;
+                for (std::size_t i = 0; i < m_n_bins; i++)
+                    total += errors[i];
+
+                return total;
+            }
+
+            /**
+             * Add the squares of the errors of all the rows to `error`, `error_up` and `error_down`:
+             * the systematics are uncorrelated
+             */
+            void addSquares(float* error, float* error_up, float* error_down) const {
+                for (std::size_t row = 0; row < m_rows; row++) {
+                    addSquare(this->error(row), m_n_bins, error);
+                    addSquare(errorUp(row), m_n_bins, error_up);
+                    addSquare(errorDown(row), m_n_bins, error_down);
+                }
+            }
+
+        private:
+            std::size_t m_n_bins;
+            std::size_t m_rows;
+
+            std::vector<float> m_error;
+            std::vector<float> m_error_up;
+            std::vector<float> m_error_down;
+
+            // Errors of the last variation added
+            std::vector<float> m_errors;
+            std::vector<float> m_errors_up;
+            std::vector<float> m_errors_down;
+    };
+}
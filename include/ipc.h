@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include <sys/types.h>
+
+namespace plotIt {
+
+    /**
+     * Blocking helpers to exchange data with the helper processes through pipes. They
+     * return false if the other end is gone.
+     */
+    bool writeAll(int fd, const void* data, std::size_t size);
+    bool readAll(int fd, void* data, std::size_t size);
+
+    // Length-prefixed strings
+    bool writeString(int fd, const std::string& value);
+    bool readString(int fd, std::string& value);
+
+    /**
+     * Forked process fed by this one through a pipe, e.g. to write files while this one goes
+     * on. When the trace is enabled, the helper sends its measurements back once done.
+     *
+     * While the helper runs, SIGPIPE is ignored: a dead helper is reported by the writes
+     * to `fd()` failing.
+     */
+    class HelperProcess {
+        public:
+            HelperProcess() = default;
+            ~HelperProcess();
+
+            HelperProcess(const HelperProcess&) = delete;
+            HelperProcess& operator=(const HelperProcess&) = delete;
+
+            /**
+             * Fork the helper, called `name` in the messages and in the trace. It runs `body` with
+             * the read end of the pipe, and fails if `body` returns false. Return false, with
+             * errno set, if the helper cannot be started.
+             */
+            bool start(const std::string& name, const std::function<bool(int)>& body);
+
+            bool running() const {
+                return m_pid > 0;
+            }
+
+            // Write end of the pipe, or -1 once closed
+            int fd() const {
+                return m_fd;
+            }
+
+            /**
+             * Close the pipe: the helper sees the end of its input
+             */
+            void closePipe();
+
+            /**
+             * Close the pipe and wait for the helper. Return false, once reported, if it failed.
+             */
+            bool finish();
+
+        private:
+            std::string m_name;
+
+            pid_t m_pid = -1;
+            int m_fd = -1;
+            // Measurements of the helper, when tracing
+            int m_timing_fd = -1;
+
+            void (*m_previous_sigpipe_handler)(int) = nullptr;
+    };
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+namespace plotIt {
+
+    /**
+     * Record of the outputs produced by a previous run, stored in the output folder.
+     *
+     * Each output (a plot, or a table) is recorded with a hash of everything it was produced
+     * from: the configuration, the command line options and the input files. An output whose
+     * hash did not change since the previous run is up to date, and does not need to be
+     * produced again.
+     */
+    class Manifest {
+        public:
+            Manifest(const std::string& path);
+
+            /**
+             * Read the manifest of the previous run, if any
+             */
+            bool load();
+            bool save() const;
+
+            bool upToDate(const std::string& output, const std::string& hash) const;
+            void update(const std::string& output, const std::string& hash);
+
+        private:
+            std::string m_path;
+            std::map<std::string, std::string> m_outputs;
+    };
+}
@@ -22,6 +22,13 @@
 #include <types.h>
 #include <defines.h>
 #include <uuid.h>
+#include <bookkeeping.h>
+#include <writer.h>
+#include <yields.h>
+
+namespace plotIt {
+  class Manifest;
+}
 
 namespace YAML {
   class Node;
@@ -39,9 +46,16 @@ namespace plotIt {
   class plotIt {
     public:
       plotIt(const fs::path& outputPath);
+      ~plotIt();
+
+      plotIt(const plotIt&) = delete;
+      plotIt& operator=(const plotIt&) = delete;
+
       bool parseConfigurationFile(const std::string& file, const fs::path& histogramsPath);
       void plotAll();
 
+      bool overridePlot(const std::string& name, const YAML::Node& overrides);
+
       // a bit of infrastructure to retrieve selected file lists
       // stored as vector<const*> but behaving as reference vectors
       class file_list {
@@ -63,10 +77,13 @@ namespace plotIt {
       private:
         std::vector<const File*> m_sFiles;
       };
+      // Files merged into another one are never returned
       template<typename Predicate>
       file_list getFiles(Predicate pred) const {
         file_list result;
-        std::copy_if(std::begin(m_files), std::end(m_files), std::back_inserter(result), pred);
+        std::copy_if(std::begin(m_files), std::end(m_files), std::back_inserter(result), [&pred](const File& file) {
+            return ! file.merged && pred(file);
+          });
         return result;
       }
 
@@ -79,26 +96,66 @@ namespace plotIt {
         return m_config;
       }
 
+      double getNormalisation(const File& file) const;
+
+      // Number of distinct systematics names: ids are in [0, count)
+      std::size_t getSystematicsCount() const {
+        return m_systematics_ids.size();
+      }
+
       std::shared_ptr<PlotStyle> getPlotStyle(const File& file);
 
       friend PlotStyle;
+      friend class Server;
 
     private:
       void checkOrThrow(YAML::Node& node, const std::string& name, const std::string& file);
       void parseIncludes(YAML::Node& node, const fs::path& base);
       void parseSystematicsNode(const YAML::Node& node);
+      void findApplicableSystematics();
       void parseFileNode(File& file, const YAML::Node& key, const YAML::Node& value);
       void parseFileNode(File& file, const YAML::Node& node);
+      void parsePlotNode(const std::string& name, const YAML::Node& node, std::vector<Plot>& plots);
+
+      // Range [first, second) of plots loaded in memory at the same time
+      typedef std::pair<std::size_t, std::size_t> Chunk;
+
+      void setUpStyle();
 
       // Plot method
       bool plot(Plot& plot);
-      bool yields(std::vector<Plot>::iterator plots_begin, std::vector<Plot>::iterator plots_end);
-      bool systematics(std::vector<Plot>::iterator plots_begin, std::vector<Plot>::iterator plots_end);
+      // `first_position` is the index of `plots_begin` among all the plots
+      bool collectYields(std::vector<Plot>::iterator plots_begin, std::vector<Plot>::iterator plots_end, YieldsTable& table, std::size_t first_position = 0);
+      bool hasDirectYields() const;
+      bool integrateLoaded(File& file, Plot& plot, ProcessIntegrals& integrals);
+      bool integrateFromFile(File& file, Plot& plot, ProcessIntegrals& integrals);
+      bool yields(YieldsTable& table);
+      bool systematics(YieldsTable& table);
+
+      bool splitInChunks(const std::vector<Plot>& plots, std::vector<Chunk>& chunks);
+      bool processChunk(std::vector<Plot>& plots, const Chunk& chunk, YieldsTable& table);
+      void releaseChunk();
+      bool runWorkers(std::vector<Plot>& plots, const std::vector<Chunk>& chunks);
+      bool runWorker(std::size_t worker, std::vector<Plot>& plots, const std::vector<Chunk>& chunks, int fd);
+      fs::path getWorkerOutput(std::size_t worker, const std::string& name) const;
+      void closeFiles();
+
+      BookKeeper::Mode getBookKeepingMode() const;
+      std::vector<fs::path> getOutputs(const Plot& plot) const;
+      std::string getGlobalHash() const;
+      std::string getPlotHash(const Plot& plot, const std::string& global_hash) const;
+      void selectOutdatedPlots(std::vector<Plot>& plots, const Manifest& manifest, const std::string& global_hash);
+      void updateManifest(const std::vector<Plot>& plots, Manifest& manifest, const std::string& global_hash);
 
       bool expandFiles();
+      bool resolveGeneratedEvents();
       bool expandObjects(File& file, std::vector<Plot>& plots);
       bool loadAllObjects(File& file, std::vector<Plot>::const_iterator plots_begin, std::vector<Plot>::const_iterator plots_end);
       bool loadObject(File& file, const Plot& plot);
+      void findMergeableFiles();
+      void mergeFiles(std::vector<Plot>::const_iterator plots_begin, std::vector<Plot>::const_iterator plots_end);
+      void mergeObjects(const std::vector<std::pair<File*, double>>& members, const Plot& plot);
+      bool openFile(File& file);
 
       void fillLegend(TLegend& legend, const Plot& plot, bool with_uncertainties);
 
@@ -110,12 +167,22 @@ namespace plotIt {
 
       std::vector<File> m_files;
       std::vector<Plot> m_plots;
+      // Configuration of each plot, by name, as written in the configuration file
+      std::map<std::string, YAML::Node> m_plot_nodes;
       std::vector<SystematicPtr> m_systematics;
       std::vector<SystematicPtr> m_systematics_siglike;
+      std::map<std::string, std::size_t> m_systematics_ids;
       std::map<std::string, Group> m_legend_groups;
       std::map<std::string, Group> m_yields_groups;
 
-      std::unordered_map<std::string, TDirectory*> m_book_keeping_folders;
+      BookKeeper m_book_keeper;
+      CanvasWriter m_writer;
+
+      // Incremental runs: hash of the configuration without the plots, and what's left to produce
+      std::string m_config_hash;
+      bool m_incremental = false;
+      bool m_tables_outdated = true;
+      std::string m_tables_hash;
 
       // Current style
       std::shared_ptr<TStyle> m_style;
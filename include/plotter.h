@@ -21,6 +21,13 @@ namespace plotIt {
       virtual boost::optional<Summary> plot(TCanvas& c, Plot& plot) = 0;
       virtual bool supports(TObject& object) = 0;
 
+      // Forget anything kept from the previous plots, whose objects are gone
+      virtual void reset() {}
+
+      bool belongsTo(const plotIt& plotIt) const {
+        return &m_plotIt == &plotIt;
+      }
+
     protected:
       plotIt& m_plotIt;
 
@@ -5,12 +5,25 @@
 
 #include <boost/optional.hpp>
 
+#include <algorithm>
+
 namespace plotIt {
   static std::vector<std::shared_ptr<plotter>> s_plotters;
   void createPlotters(plotIt& plotIt) {
     s_plotters.push_back(std::make_shared<TH1Plotter>(plotIt));
   }
 
+  void destroyPlotters(const plotIt& plotIt) {
+    s_plotters.erase(std::remove_if(s_plotters.begin(), s_plotters.end(), [&plotIt](const std::shared_ptr<plotter>& p) {
+          return p->belongsTo(plotIt);
+        }), s_plotters.end());
+  }
+
+  void resetPlotters() {
+    for (auto& plotter: s_plotters)
+      plotter->reset();
+  }
+
   boost::optional<Summary> plot(const File& file, TCanvas& c, Plot& plot) {
     for (auto& plotter: s_plotters) {
       if (plotter->supports(*file.object))
@@ -18,6 +18,10 @@ namespace plotIt {
                 m_temporaryObjects.push_back(object);
             }
 
+            /**
+             * Keep an object alive until the end of the current chunk of plots, or until
+             * the end of the run if no chunk is being processed
+             */
             void addRuntime(const std::shared_ptr<TObject>& object) {
                 m_temporaryObjectsRuntime.push_back(object);
             }
@@ -26,6 +30,21 @@ namespace plotIt {
                 m_temporaryObjects.clear();
             }
 
+            void beginChunk() {
+                m_chunkStart = m_temporaryObjectsRuntime.size();
+                m_inChunk = true;
+            }
+
+            // Release everything added with `addRuntime` since `beginChunk`
+            void endChunk() {
+                if (! m_inChunk)
+                    return;
+
+                m_temporaryObjectsRuntime.erase(m_temporaryObjectsRuntime.begin() + m_chunkStart, m_temporaryObjectsRuntime.end());
+                m_temporaryObjectsRuntime.shrink_to_fit();
+                m_inChunk = false;
+            }
+
             TemporaryPool(TemporaryPool const&) = delete;             // Copy construct
             TemporaryPool(TemporaryPool&&) = delete;                  // Move construct
             TemporaryPool& operator=(TemporaryPool const&) = delete;  // Copy assign
@@ -37,5 +56,7 @@ namespace plotIt {
         private:
             std::vector<std::shared_ptr<TObject>> m_temporaryObjects;
             std::vector<std::shared_ptr<TObject>> m_temporaryObjectsRuntime;
+            std::size_t m_chunkStart = 0;
+            bool m_inChunk = false;
     };
 }
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <systematics.h>
+#include <types.h>
+
+class TObject;
+
+namespace fs = boost::filesystem;
+
+namespace plotIt {
+
+    class plotIt;
+
+    /**
+     * Long-running plotIt, answering requests on a local (unix) socket. The configuration, the
+     * open files and the histograms already read stay in memory between the requests, so that
+     * only drawing and saving is left to do when a plot is asked for again.
+     *
+     * One request per line, answered by a single line starting with `ok` or `error:`:
+     *
+     *   plot <name>               draw the plots with this name, glob patterns allowed
+     *   yields                    write the yields table, and the systematics table with -s
+     *   override <name> <yaml>    merge a YAML map into the configuration of a plot, as named in
+     *                             the configuration file, e.g. `override histo_* {log-y: true}`
+     *   reload                    parse the configuration file again
+     *   quit                      stop the server
+     *
+     * e.g. `echo "plot histo_1" | socat - UNIX-CONNECT:<socket>`
+     */
+    class Server {
+        public:
+            Server(const fs::path& outputPath, const std::string& configFile, const fs::path& histogramsPath);
+            ~Server();
+
+            bool run(const std::string& socket_path);
+
+        private:
+            // Histograms of a plot as they are once loaded, before any drawing, indexed like the files
+            struct Resident {
+                std::vector<std::shared_ptr<TObject>> objects;
+                std::vector<std::vector<SystematicSet>> systematics;
+                std::vector<std::vector<SystematicSet>> systematics_siglike;
+            };
+
+            std::unique_ptr<plotIt> parse();
+            bool expand();
+
+            void serve(int client, bool& quit);
+            std::string handle(const std::string& request, bool& quit);
+
+            std::string plot(const std::string& pattern);
+            std::string yields();
+            std::string overridePlot(const std::string& arguments);
+            std::string reload();
+
+            bool load(const std::vector<Plot>& plots);
+            void install(std::vector<Plot>& plots);
+
+            fs::path m_outputPath;
+            std::string m_configFile;
+            fs::path m_histogramsPath;
+
+            std::unique_ptr<plotIt> m_plotIt;
+
+            // Plots of the configuration, once glob patterns are expanded
+            std::vector<Plot> m_plots;
+
+            // By name of plot
+            std::unordered_map<std::string, Resident> m_resident;
+    };
+}
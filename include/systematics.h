@@ -1,9 +1,13 @@
 #pragma once
 
+#include <functional>
+#include <map>
 #include <string>
 #include <memory>
 #include <regex>
 
+#include <cow_ptr.h>
+
 namespace YAML {
     class Node;
 };
@@ -24,16 +28,32 @@ namespace plotIt {
     struct Systematic;
 
     struct SystematicSet {
-        std::shared_ptr<TObject> true_nominal_shape;
-        std::shared_ptr<TObject> true_up_shape;
-        std::shared_ptr<TObject> true_down_shape;
+        // Shapes are shared, between the sets and with the true shapes, until they are modified
+        cow_ptr<TObject> true_nominal_shape;
+        cow_ptr<TObject> true_up_shape;
+        cow_ptr<TObject> true_down_shape;
+
+        cow_ptr<TObject> nominal_shape;
+        cow_ptr<TObject> up_shape;
+        cow_ptr<TObject> down_shape;
 
-        std::shared_ptr<TObject> nominal_shape;
-        std::shared_ptr<TObject> up_shape;
-        std::shared_ptr<TObject> down_shape;
+        // Normalisation-only systematics do not hold any shape: their variations are
+        // the nominal histogram of the file, scaled by these factors
+        bool normalisation_only = false;
+        float up_factor = 1;
+        float down_factor = 1;
 
         void update();
 
+        // Transformed shapes, by original shape
+        typedef std::map<const TObject*, cow_ptr<TObject>> TransformCache;
+
+        /**
+         * Assume objects are histograms and apply `f` on each of them. A shape shared by
+         * several sets is transformed only once, as long as the same cache is used.
+         **/
+        void transform(const std::function<void(TH1*)>& f, TransformCache& cache);
+
         /**
          * Assume objects are histograms and scale them by the specified factor
          **/
@@ -45,8 +65,9 @@ namespace plotIt {
          **/
         void rebin(size_t factor);
 
-        std::string name() const;
-        std::string prettyName() const;
+        const std::string& name() const;
+        const std::string& prettyName() const;
+        std::size_t id() const;
 
         private:
         friend struct Systematic;
@@ -61,6 +82,9 @@ namespace plotIt {
         std::string pretty_name;
         std::regex on;
 
+        // Systematics with the same name share the same id, from 0 to the number of names
+        std::size_t id = 0;
+
         /**
          * Apply the systematic on the given set
          **/
@@ -68,16 +92,22 @@ namespace plotIt {
 
         /**
          * Load from the file the necessary objects. Default implementation only
-         * clones the nominal histograms. Up and down variation are computed when
+         * shares the nominal histogram. Up and down variation are computed when
          * apply is called.
          */
-        virtual SystematicSet newSet(TObject* nominal, File& file, const Plot& plot);
+        virtual SystematicSet newSet(const cow_ptr<TObject>& nominal, File& file, const Plot& plot);
+
+        protected:
+        /**
+         * Create a set without any shape, whose variations are the nominal scaled by `up` and `down`
+         */
+        SystematicSet newNormalisationSet(float up, float down);
     };
 
     struct ConstantSystematic: public Systematic {
         ConstantSystematic(const YAML::Node& node);
 
-        virtual void apply(SystematicSet&) override;
+        virtual SystematicSet newSet(const cow_ptr<TObject>& nominal, File& file, const Plot& plot) override;
 
         float value;
     };
@@ -85,7 +115,7 @@ namespace plotIt {
     struct LogNormalSystematic: public Systematic {
         LogNormalSystematic(const YAML::Node& node);
 
-        virtual void apply(SystematicSet&) override;
+        virtual SystematicSet newSet(const cow_ptr<TObject>& nominal, File& file, const Plot& plot) override;
 
         void eval();
 
@@ -101,7 +131,14 @@ namespace plotIt {
 
     struct ShapeSystematic: public Systematic {
         ShapeSystematic(const YAML::Node& node);
-        virtual SystematicSet newSet(TObject* nominal, File& file, const Plot& plot) override;
+        virtual SystematicSet newSet(const cow_ptr<TObject>& nominal, File& file, const Plot& plot) override;
+
+        /**
+         * Read a variation of the nominal histogram of a plot, either from the file itself
+         * or from its friend file. Null if there is none.
+         */
+        std::shared_ptr<TObject> loadVariation(File& file, const Plot& plot, Variation variation);
+
         float ext_sum_weight_up = 1.0;
         float ext_sum_weight_down = 1.0;
     };
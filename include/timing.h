@@ -0,0 +1,165 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace plotIt {
+
+    /**
+     * Wall-clock time spent in each phase of a run, accumulated over all the plots.
+     *
+     * Phases are timed with `Timing::Scope`. Scopes can be nested: the time is always
+     * attributed to the innermost phase only, so that the phases add up to the time spent
+     * in all the scopes. Nothing is measured unless the timing is enabled.
+     *
+     * When the trace is enabled, each scope is also recorded as an event, with its wall-clock
+     * and CPU time and what it was working on, and the events are written as a Chrome trace
+     * (chrome://tracing, Perfetto). Scopes without a phase only add to the trace.
+     *
+     * Forked processes measure on their own, after a `reset`, and hand their measurements
+     * to their parent through `write` and `read`: one track per process in the trace.
+     */
+    class Timing {
+        public:
+            enum Phase {
+                PARSE,
+                LOAD,
+                SYSTEMATICS,
+                STACK,
+                DRAW,
+                SAVE,
+                YIELDS,
+                N_PHASES
+            };
+
+            static Timing& get() {
+                static Timing s_instance;
+
+                return s_instance;
+            }
+
+            static const char* name(Phase phase);
+
+            void enable() {
+                m_enabled = true;
+                m_start = clock::now();
+            }
+
+            bool enabled() const {
+                return m_enabled;
+            }
+
+            void enableTrace(const std::string& path);
+
+            bool tracing() const {
+                return ! m_trace_path.empty();
+            }
+
+            /**
+             * Forget everything measured so far, e.g. in a forked worker, named `process_name`
+             * in the trace
+             */
+            void reset(const std::string& process_name = std::string());
+
+            void write(std::ostream& out) const;
+
+            /**
+             * Add the measurements written by another process
+             */
+            bool read(std::istream& in);
+
+            // Same, through a pipe
+            bool write(int fd) const;
+            bool read(int fd);
+
+            /**
+             * Write the report, as JSON: the seconds spent and the number of scopes for each
+             * phase, and the wall-clock time since the timing was enabled.
+             */
+            bool writeReport(const std::string& path) const;
+
+            /**
+             * Write the trace, including the events of the other processes
+             */
+            bool writeTrace() const;
+
+            class Scope {
+                public:
+                    /**
+                     * Time a phase. In the trace, the event is called `name`, or after the phase
+                     * if there is no name, and `detail` tells what it was working on
+                     */
+                    explicit Scope(Phase phase, const char* name = nullptr, const std::string& detail = std::string());
+
+                    /**
+                     * Record an event in the trace only
+                     */
+                    explicit Scope(const char* name, const std::string& detail = std::string());
+
+                    ~Scope();
+
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+
+                private:
+                    bool m_active;
+                    bool m_timed;
+                    const char* m_name;
+                    std::string m_detail;
+                    int64_t m_start;
+                    int64_t m_cpu_start;
+            };
+
+            Timing(const Timing&) = delete;
+            Timing& operator=(const Timing&) = delete;
+
+        private:
+            typedef std::chrono::steady_clock clock;
+
+            struct Event {
+                const char* name;
+                std::string detail;
+                int64_t start;
+                int64_t duration;
+                int64_t cpu_start;
+                int64_t cpu_duration;
+            };
+
+            Timing();
+
+            void begin(Phase phase);
+            void end();
+
+            // Add the time since the last change of phase to the current phase
+            void accumulate(clock::time_point now);
+
+            // Microseconds since the trace was enabled, the same for all the processes
+            int64_t traceNow() const;
+            // CPU time of the calling thread, in microseconds
+            static int64_t cpuNow();
+
+            // Trace events of this process, one per line, with `separator` between them
+            void writeEvents(std::ostream& out, const char* separator) const;
+
+            bool m_enabled = false;
+            clock::time_point m_start;
+
+            double m_seconds[N_PHASES];
+            std::size_t m_calls[N_PHASES];
+
+            std::vector<Phase> m_phases;
+            clock::time_point m_since;
+
+            std::string m_trace_path;
+            int64_t m_trace_origin = 0;
+            std::string m_process_name = "plotIt";
+            std::vector<Event> m_events;
+
+            // Events read from the other processes, already written as JSON
+            std::vector<std::string> m_other_events;
+    };
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class TH1;
+
+namespace plotIt {
+
+    /**
+     * Fill several histograms in a single pass over a chain of trees.
+     *
+     * Each histogram is filled like TTree::Draw would do: the draw expression is evaluated
+     * for each entry and weighted by the selection expression and by the tree weight.
+     *
+     * The entries can be shared between several threads. They are split into blocks of a
+     * fixed size. Each block records the values and weights of its fills, and the fills are
+     * replayed into the histograms in the order of the blocks: the histograms are filled
+     * exactly as by a single pass over the chain, whatever the number of threads, down to
+     * the rounding of their contents.
+     */
+    class TreeFiller {
+        public:
+            TreeFiller(const std::string& tree_name, const std::string& path);
+            ~TreeFiller();
+
+            void book(TH1* hist, const std::string& draw, const std::string& selection);
+
+            bool fill(unsigned int threads = 1);
+
+            static constexpr long long entries_per_block = 100000;
+
+        private:
+            struct Booking {
+                TH1* hist;
+                std::string draw;
+                std::string selection;
+            };
+
+            // Value and weight of each fill of a block, for each booking
+            typedef std::vector<std::vector<std::pair<double, double>>> Fills;
+
+            class Worker;
+
+            std::string m_tree_name;
+            std::string m_path;
+            std::vector<Booking> m_bookings;
+    };
+}
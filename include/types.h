@@ -1,10 +1,12 @@
 #pragma once
 
 #include <boost/algorithm/string/join.hpp>
+#include <boost/dynamic_bitset.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
 
 #include <iostream>
+#include <unordered_map>
 
 #include <defines.h>
 #include <uuid.h>
@@ -17,9 +19,13 @@
 #include <TChain.h>
 
 class TLegendEntry;
+class TKey;
 
 namespace plotIt {
 
+  // Keys of a ROOT file, indexed by their full path inside the file
+  typedef std::unordered_map<std::string, TKey*> KeyIndex;
+
   enum Type {
     MC,
     SIGNAL,
@@ -125,6 +131,10 @@ namespace plotIt {
   struct RenameOp {
       std::regex from;
       std::string to;
+
+      // Patterns without any special character are replaced as plain strings, without regex
+      bool literal = false;
+      std::string literal_from;
   };
 
   struct File {
@@ -158,15 +168,26 @@ namespace plotIt {
     std::map<std::string, std::vector<SystematicSet>> systematics_cache;
     std::map<std::string, std::vector<SystematicSet>> systematics_cache_siglike;
 
-    int16_t order = std::numeric_limits<int16_t>::min();
+    // Systematics applying to this file, indexed like the lists of systematics of the configuration
+    boost::dynamic_bitset<> applicable_systematics;
+    boost::dynamic_bitset<> applicable_systematics_siglike;
 
-    std::shared_ptr<TChain> chain;
+    int16_t order = std::numeric_limits<int16_t>::min();
 
     std::shared_ptr<TFile> handle;
+    std::shared_ptr<KeyIndex> keys;
     std::map<std::string, std::shared_ptr<TFile>> friend_handles;
+    std::map<std::string, std::shared_ptr<KeyIndex>> friend_keys;
 
     // Renaming
     std::vector<RenameOp> renaming_ops;
+    // Name of the objects in the file, by plot name
+    std::unordered_map<std::string, std::string> renamed_objects;
+
+    // Same process in other eras, merged into this file after loading (indices in the list of files)
+    std::vector<size_t> merged_files;
+    // True if this file is merged into another one, and must be ignored afterwards
+    bool merged = false;
   };
 
   struct Group {
@@ -372,6 +393,12 @@ namespace plotIt {
     // Show or hide ticks for each axis
     bool x_axis_hide_ticks = false;
     bool y_axis_hide_ticks = false;
+
+    // Hash of the configuration of the plot, for incremental runs
+    std::string config_hash;
+
+    // The outputs of a previous run are still valid: the plot does not need to be drawn again
+    bool up_to_date = false;
     
     void print() {
       std::cout << "Plot '" << name << "'" << std::endl;
@@ -424,6 +451,9 @@ namespace plotIt {
     float scale = 1;
     bool no_lumi_rescaling = false;
 
+    // Merge the files of the same process from different eras before plotting
+    bool merge_eras = false;
+
     // Systematics
     float luminosity_error_percent = 0;
     bool syst_only = false;
@@ -486,7 +516,7 @@ namespace plotIt {
     std::map<Type, std::vector<LegendEntry>> static_legend_entries;
 
     std::string book_keeping_file_name;
-    std::shared_ptr<TFile> book_keeping_file;
+    std::string book_keeping_mode = "canvas"; // "canvas" or "primitives"
 
     // Axis label size
     float x_axis_label_size = LABEL_FONTSIZE;
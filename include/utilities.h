@@ -196,5 +196,53 @@ namespace plotIt {
 
   TDirectory* getDirectory(TDirectoryFile* root, const boost::filesystem::path& directory, bool create = true);
 
+  /**
+   * Index all the keys of a directory and of its sub-directories. Only the highest cycle of each key is kept.
+   */
+  std::shared_ptr<KeyIndex> indexKeys(TDirectory* root);
+
+  /**
+   * Open a ROOT file and index its keys, unless it's already opened
+   */
+  bool openRootFile(const std::string& path, std::shared_ptr<TFile>& handle, std::shared_ptr<KeyIndex>& keys);
+
+  /**
+   * Read an object through a key index. The returned object is owned by the caller,
+   * and is null if there is no such key.
+   */
+  std::shared_ptr<TObject> getObject(const KeyIndex& keys, const std::string& name);
+
+  /**
+   * Copy all the objects of a directory, and of its sub-directories, into another one,
+   * overwriting the objects with the same name
+   */
+  void copyObjects(TDirectory* from, TDirectory* to);
+
+  /**
+   * 64 bits FNV-1a hash of a string, as an hexadecimal string
+   */
+  std::string hashString(const std::string& value);
+
+  /**
+   * Absolute path, inode, modification and change times and size of a file, or an empty string
+   * if it does not exist
+   */
+  std::string fileIdentity(const std::string& path);
+
+  /**
+   * Peak resident memory of the process since the last call to `resetPeakMemory`, in bytes,
+   * or 0 if not available
+   */
+  std::size_t getPeakMemory();
+
+  void resetPeakMemory();
+
+    RenameOp makeRenameOp(const std::string& from, const std::string& to);
+
     std::string applyRenaming(const std::vector<RenameOp>& ops, const std::string input);
+
+    /**
+     * Name of the object of a plot in a file, after renaming. Memoised per file.
+     */
+    const std::string& getObjectName(File& file, const std::string& plot_name);
 }
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <ipc.h>
+
+#include <boost/filesystem.hpp>
+
+#include <vector>
+
+class TCanvas;
+
+namespace plotIt {
+
+    /**
+     * Save canvases to their output files.
+     *
+     * Once started, encoding the images is done by a separate process: each canvas is
+     * serialized and sent through a pipe, and the next plot can be drawn while the previous
+     * ones are being written. The writer holds at most `queue_size` canvases waiting to be
+     * written; when it's full, saving a canvas blocks until there is room again.
+     *
+     * When not started, canvases are saved directly.
+     */
+    class CanvasWriter {
+        public:
+            CanvasWriter() = default;
+            ~CanvasWriter();
+
+            CanvasWriter(const CanvasWriter&) = delete;
+            CanvasWriter& operator=(const CanvasWriter&) = delete;
+
+            bool start();
+
+            bool save(TCanvas& canvas, const std::vector<boost::filesystem::path>& outputs);
+
+            /**
+             * Wait until all the canvases are written. Return false if the writer failed.
+             */
+            bool finish();
+
+            static constexpr std::size_t queue_size = 4;
+
+        private:
+            void run(int fd);
+
+            HelperProcess m_process;
+
+            // In the writer process: some canvases could not be written
+            bool m_failed = false;
+    };
+}
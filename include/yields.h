@@ -0,0 +1,85 @@
+#pragma once
+
+#include <types.h>
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace plotIt {
+
+    /**
+     * Everything needed to write the yields and systematics tables, as plain numbers.
+     *
+     * The content is filled from the 'for-yields' plots of each chunk in turn, and only holds
+     * a few numbers per category and process. It can be merged and serialized, so that several
+     * processes can each fill their own share of the table.
+     */
+    struct YieldsTable {
+        typedef std::tuple<Type, std::string, std::string> ProcessKey; // Type, category, process name
+        typedef std::map<std::string, std::map<std::string, std::pair<double, double>>> ProcessYields;
+
+        std::map<std::string, double> data_yields;
+
+        ProcessYields mc_yields;
+        std::map<std::string, double> mc_total;
+        std::map<std::string, double> mc_total_sqerrs;
+        std::set<std::string> mc_processes;
+
+        ProcessYields signal_yields;
+        std::set<std::string> signal_processes;
+
+        std::map<ProcessKey, double> process_systematics;
+        std::map<ProcessKey, double> process_systematics_up;
+        std::map<ProcessKey, double> process_systematics_dn;
+
+        std::map<std::string, std::map<Type, double>> total_systematics_squared;
+        std::map<std::string, std::map<Type, double>> total_systematics_squared_up;
+        std::map<std::string, std::map<Type, double>> total_systematics_squared_dn;
+
+        std::vector<std::pair<int, std::string>> categories;
+        // Index of the plot which filled each category, among all the plots
+        std::map<std::string, uint64_t> category_positions;
+
+        bool has_data = false;
+
+        bool empty() const {
+            return categories.empty();
+        }
+
+        bool hasCategory(const std::string& category) const;
+
+        /**
+         * Add the content of another table. As when a single table is filled with all the
+         * plots, a category present in both comes from the plot with the lowest index, and
+         * the categories are ordered like their plots.
+         */
+        void merge(const YieldsTable& other);
+
+        void write(std::ostream& out) const;
+        bool read(std::istream& in);
+    };
+
+    /**
+     * Rescaled integrals, including the under- and overflow, of the histograms of a process
+     * for one plot: all that the yields tables need to know about it
+     */
+    struct ProcessIntegrals {
+        struct Systematic {
+            std::size_t id;
+            double nominal;
+            double up;
+            double down;
+        };
+
+        double yield = 0;
+        double sqerror = 0;
+
+        std::vector<Systematic> systematics;
+    };
+}
@@ -14,8 +14,13 @@
 #include <TLegend.h>
 #include <TROOT.h>
 
+#include <algorithm>
+#include <numeric>
+
 #include <commandlinecfg.h>
+#include <envelope.h>
 #include <pool.h>
+#include <timing.h>
 #include <utilities.h>
 
 namespace plotIt {
@@ -91,11 +96,30 @@ namespace plotIt {
         return g;
     }
 
+    /*!
+     * Copy the content of all the bins of `h`, including underflow and overflow. The storage
+     * of the histogram is read directly when possible, instead of calling GetBinContent on each bin
+     */
+    void getBinContents(const TH1* h, double* contents) {
+        std::size_t n = h->GetNbinsX() + 2;
+
+        if (const TArrayD* array = dynamic_cast<const TArrayD*>(h)) {
+            std::copy(array->GetArray(), array->GetArray() + n, contents);
+        } else if (const TArrayF* array = dynamic_cast<const TArrayF*>(h)) {
+            std::copy(array->GetArray(), array->GetArray() + n, contents);
+        } else {
+            for (std::size_t i = 0; i < n; i++)
+                contents[i] = h->GetBinContent(i);
+        }
+    }
+
   bool TH1Plotter::supports(TObject& object) {
     return object.InheritsFrom("TH1");
   }
 
   TH1Plotter::Stacks TH1Plotter::buildStacks(bool sortByYields) {
+      Timing::Scope timing(Timing::STACK, "buildStacks");
+
       std::set<int64_t> indices;
 
       for (auto& file: m_plotIt.getFiles()) {
@@ -157,6 +181,7 @@ namespace plotIt {
       }
 
       std::vector<std::tuple<TH1*, std::string>> histograms_in_stack;
+      std::vector<std::shared_ptr<TH1>> stacked_group_histograms;
 
       for ( auto& file: m_plotIt.getFiles([this,index] ( const File& f ) {
             return ( f.type == MC ) && ( f.stack_index == index )
@@ -166,7 +191,6 @@ namespace plotIt {
           TH1* nominal = dynamic_cast<TH1*>(file.object);
           if (!stack) {
               stack = std::make_shared<THStack>(stack_name.c_str(), stack_name.c_str());
-              TemporaryPool::get().add(stack);
           }
 
           // Try to find if this file is a member of a group
@@ -182,7 +206,7 @@ namespace plotIt {
               continue;
           } else if (it != group_histograms.end()) {
               auto n = it->second;
-              TemporaryPool::get().add(n);
+              stacked_group_histograms.push_back(n);
 
               nominal = n.get();
 
@@ -222,16 +246,22 @@ namespace plotIt {
       }
 
       Stack s {stack, histo_merged};
+      s.group_histograms = stacked_group_histograms;
 
       return s;
   }
 
-  void TH1Plotter::computeSystematics(int64_t index, Stack& stack, Summary& summary) {
+  void TH1Plotter::computeSystematics(int64_t index, Stack& stack, Summary& summary, const NominalContents& nominal_contents) {
 
-      // Key is systematics name, value is the combined systematics value for each bin
-      std::map<std::string, std::vector<float>> combined_systematics_map;
-      std::map<std::string, std::vector<float>> combined_systematics_map_up;
-      std::map<std::string, std::vector<float>> combined_systematics_map_dn;
+      std::size_t n_bins = stack.syst_only->GetNbinsX();
+
+      // One row per systematics id, with the combined systematics value for each bin
+      SystematicsEnvelope envelope(n_bins, m_plotIt.getSystematicsCount());
+
+      // Bin contents, including underflow and overflow
+      std::vector<double> nominal(n_bins + 2);
+      std::vector<double> up(n_bins + 2);
+      std::vector<double> down(n_bins + 2);
 
       for ( auto& file: m_plotIt.getFiles([this,index] ( const File& f ) {
             return ( f.type != DATA ) && ( ! f.systematics->empty() )
@@ -240,49 +270,53 @@ namespace plotIt {
 
           for (auto& syst: *file.systematics) {
 
-              std::vector<float>* combined_systematics;
-              std::vector<float>* combined_systematics_up;
-              std::vector<float>* combined_systematics_dn;
-              auto map_it = combined_systematics_map.find(syst.name());
-              auto map_it_up = combined_systematics_map_up.find(syst.name());
-              auto map_it_dn = combined_systematics_map_dn.find(syst.name());
-
-              if (map_it == combined_systematics_map.end()) {
-                  combined_systematics = &combined_systematics_map[syst.name()];
-                  combined_systematics->resize(stack.syst_only->GetNbinsX(), 0.);
-              } else {
-                  combined_systematics = &map_it->second;
-              }
-              if (map_it_up == combined_systematics_map_up.end()) {
-                  combined_systematics_up = &combined_systematics_map_up[syst.name()];
-                  combined_systematics_up->resize(stack.syst_only->GetNbinsX(), 0.);
-              } else {
-                  combined_systematics_up = &map_it_up->second;
-              }
-              if (map_it_dn == combined_systematics_map_dn.end()) {
-                  combined_systematics_dn = &combined_systematics_map_dn[syst.name()];
-                  combined_systematics_dn->resize(stack.syst_only->GetNbinsX(), 0.);
-              } else {
-                  combined_systematics_dn = &map_it_dn->second;
-              }
-
               TH1* nominal_shape = static_cast<TH1*>(syst.nominal_shape.get());
               TH1* up_shape = static_cast<TH1*>(syst.up_shape.get());
               TH1* down_shape = static_cast<TH1*>(syst.down_shape.get());
 
-              if (! nominal_shape || ! up_shape || ! down_shape)
-                  continue;
+              double nominal_integral;
+              double up_integral;
+              double down_integral;
+
+              if (syst.normalisation_only) {
+                  // Folded analytically: the variations are the nominal histogram of the
+                  // file, as it was before building the stacks, scaled by a factor
+                  auto contents = nominal_contents.find(&file);
+                  if (contents == nominal_contents.end())
+                      continue;
 
+                  std::copy(contents->second.begin(), contents->second.end(), nominal.begin());
+
+                  for (std::size_t i = 0; i < n_bins + 2; i++) {
+                      up[i] = nominal[i] * syst.up_factor;
+                      down[i] = nominal[i] * syst.down_factor;
+                  }
+
+                  // Same as TH1::Integral: without underflow and overflow
+                  nominal_integral = std::accumulate(nominal.begin() + 1, nominal.begin() + n_bins + 1, 0.);
+                  up_integral = nominal_integral * syst.up_factor;
+                  down_integral = nominal_integral * syst.down_factor;
+              } else {
+                  if (! nominal_shape || ! up_shape || ! down_shape)
+                      continue;
+
+                  getBinContents(nominal_shape, nominal.data());
+                  getBinContents(up_shape, up.data());
+                  getBinContents(down_shape, down.data());
+
+                  nominal_integral = nominal_shape->Integral();
+                  up_integral = up_shape->Integral();
+                  down_integral = down_shape->Integral();
+              }
 
-              float total_syst_error = 0;
               float total_syst_error_up = 0;
               float total_syst_error_dn = 0;
 
               // First, calculate up/down yield variation
               // here, up is defined by the integram of (var-nom) > 0
               // If one-sided, uncs are square-summed
-              float temp_total_syst_error_up = up_shape->Integral() - nominal_shape->Integral();
-              float temp_total_syst_error_down = down_shape->Integral() - nominal_shape->Integral();
+              float temp_total_syst_error_up = up_integral - nominal_integral;
+              float temp_total_syst_error_down = down_integral - nominal_integral;
               if (temp_total_syst_error_up * temp_total_syst_error_down <= 0) {
                   total_syst_error_up = temp_total_syst_error_up;
                   total_syst_error_dn = temp_total_syst_error_down;
@@ -298,51 +332,12 @@ namespace plotIt {
               // However, we consider that different systematics in the same bin are totaly
               // uncorrelated. The total systematics errors is then the quadratic sum.
               // Thus, first calculate linear sum of variation per systematic source,
-              // then square sum by looping over combined_systematics_map
+              // then square sum over the rows of the envelope
               //
               // In addition, we take only larger variation in the case of one-sided unc.
-              for (uint32_t i = 1; i <= (uint32_t) stack.syst_only->GetNbinsX(); i++) {
-
-                  float syst_error_up = 0.;
-                  float syst_error_dn = 0.;
-                  float temp_syst_error_up = up_shape->GetBinContent(i) - nominal_shape->GetBinContent(i);
-                  float temp_syst_error_dn = down_shape->GetBinContent(i) - nominal_shape->GetBinContent(i);
-
-                  // Remove very small variations by hand - not applied for now
-                  //if (std::abs(temp_syst_error_up) < 1e-07) temp_syst_error_up = 1e-07;
-                  //if (std::abs(temp_syst_error_dn) < 1e-07) temp_syst_error_dn = 1e-07;
-
-                  // Normal case, double-sided
-                  if (temp_syst_error_up * temp_syst_error_dn <= 0) {
-                      if (temp_syst_error_up >= 0 and temp_syst_error_dn < 0) {
-                          syst_error_up = temp_syst_error_up;
-                          syst_error_dn = temp_syst_error_dn;
-                      } else {
-                          syst_error_up = temp_syst_error_dn;
-                          syst_error_dn = temp_syst_error_up;
-                      }
-                  // One-sided.
-                  } else {
-                      if (temp_syst_error_up > 0) {
-                          syst_error_up = std::max(temp_syst_error_up, temp_syst_error_dn);
-                          syst_error_dn = 0.0;
-                      } else {
-                          syst_error_up = 0.0;
-                          syst_error_dn = std::max(temp_syst_error_up, temp_syst_error_dn);
-                      }
-                  }
-                  float syst_error = std::max(syst_error_up, syst_error_dn);
-
-                  total_syst_error += syst_error;
-                  //std::cout << "per bin " << syst.name() << " " << syst_error << " " << syst_error_up << " " << syst_error_dn << std::endl;
-
-                  // Only propagate uncertainties for MC, not signal
-                  if (file.type == MC) {
-                      (*combined_systematics)[i - 1] += syst_error;
-                      (*combined_systematics_up)[i - 1] += syst_error_up;
-                      (*combined_systematics_dn)[i - 1] += syst_error_dn;
-                  }
-              }
+              //
+              // Only propagate uncertainties for MC, not signal
+              float total_syst_error = envelope.add(syst.id(), nominal.data() + 1, up.data() + 1, down.data() + 1, file.type == MC);
 
               SummaryItem summary_item;
               summary_item.process_id = file.id;
@@ -357,25 +352,20 @@ namespace plotIt {
 
       // Combine all systematics in one
       // Consider that all the systematics are not correlated
-      for (auto& combined_systematics: combined_systematics_map) {
-          for (size_t i = 1; i <= (size_t) stack.syst_only->GetNbinsX(); i++) {
-              float total_error = stack.syst_only->GetBinError(i);
-              stack.syst_only->SetBinError(i, std::sqrt(total_error * total_error + combined_systematics.second[i - 1] * combined_systematics.second[i - 1]));
-          }
-      }
+      std::vector<float> sum_squares(n_bins, 0.f);
+      std::vector<float> sum_squares_up(n_bins, 0.f);
+      std::vector<float> sum_squares_dn(n_bins, 0.f);
+      envelope.addSquares(sum_squares.data(), sum_squares_up.data(), sum_squares_dn.data());
 
-      for (auto& combined_systematics_up: combined_systematics_map_up) {
-          for (size_t i = 0; i < (size_t) stack.syst_only->GetNbinsX(); i++) {
-              float total_error_up = stack.syst_only_asym->GetErrorYhigh(i);
-              stack.syst_only_asym->SetPointEYhigh(i, std::sqrt(total_error_up * total_error_up + combined_systematics_up.second[i] * combined_systematics_up.second[i]));
-          }
-      }
+      for (size_t i = 0; i < n_bins; i++) {
+          float total_error = stack.syst_only->GetBinError(i + 1);
+          stack.syst_only->SetBinError(i + 1, std::sqrt(total_error * total_error + sum_squares[i]));
 
-      for (auto& combined_systematics_dn: combined_systematics_map_dn) {
-          for (size_t i = 0; i < (size_t) stack.syst_only->GetNbinsX(); i++) {
-              float total_error_down = stack.syst_only_asym->GetErrorYlow(i);
-              stack.syst_only_asym->SetPointEYlow(i, std::sqrt(total_error_down * total_error_down + combined_systematics_dn.second[i] * combined_systematics_dn.second[i]));
-          }
+          float total_error_up = stack.syst_only_asym->GetErrorYhigh(i);
+          stack.syst_only_asym->SetPointEYhigh(i, std::sqrt(total_error_up * total_error_up + sum_squares_up[i]));
+
+          float total_error_down = stack.syst_only_asym->GetErrorYlow(i);
+          stack.syst_only_asym->SetPointEYlow(i, std::sqrt(total_error_down * total_error_down + sum_squares_dn[i]));
       }
 
       // Propagate syst errors to the stat + syst histogram
@@ -391,33 +381,20 @@ namespace plotIt {
       }
 
       //////////// siglike systs
-      std::map<std::string, std::vector<float>> combined_systematics_siglike_map_up;
-      std::map<std::string, std::vector<float>> combined_systematics_siglike_map_dn;
+      // Consider that all the systematics are CORRELATED!
+      std::vector<float> combined_systematics_siglike_up(n_bins, 0.f);
+      std::vector<float> combined_systematics_siglike_dn(n_bins, 0.f);
 
       for ( auto& file: m_plotIt.getFiles([this,index] ( const File& f ) {
             return ( f.type != DATA ) && ( ! f.systematics_siglike->empty() )
                 && ( ( f.type != MC ) || ( f.stack_index == index ) ) ;
             } ) ) {
 
-          for (auto& syst: *file.systematics_siglike) {
-
-              std::vector<float>* combined_systematics_up;
-              std::vector<float>* combined_systematics_dn;
-              auto map_it_up = combined_systematics_siglike_map_up.find(syst.name());
-              auto map_it_dn = combined_systematics_siglike_map_dn.find(syst.name());
+          // Only propagate uncertainties for MC, not signal
+          if (file.type != MC)
+              continue;
 
-              if (map_it_up == combined_systematics_siglike_map_up.end()) {
-                  combined_systematics_up = &combined_systematics_siglike_map_up[syst.name()];
-                  combined_systematics_up->resize(stack.syst_only->GetNbinsX(), 0.);
-              } else {
-                  combined_systematics_up = &map_it_up->second;
-              }
-              if (map_it_dn == combined_systematics_siglike_map_dn.end()) {
-                  combined_systematics_dn = &combined_systematics_siglike_map_dn[syst.name()];
-                  combined_systematics_dn->resize(stack.syst_only->GetNbinsX(), 0.);
-              } else {
-                  combined_systematics_dn = &map_it_dn->second;
-              }
+          for (auto& syst: *file.systematics_siglike) {
 
               TH1* nominal_shape = static_cast<TH1*>(syst.nominal_shape.get());
               TH1* up_shape = static_cast<TH1*>(syst.up_shape.get());
@@ -426,59 +403,39 @@ namespace plotIt {
               if (! nominal_shape || ! up_shape || ! down_shape)
                   continue;
 
+              getBinContents(nominal_shape, nominal.data());
+              getBinContents(up_shape, up.data());
+              getBinContents(down_shape, down.data());
 
-              for (uint32_t i = 1; i <= (uint32_t) stack.syst_only->GetNbinsX(); i++) {
-
-                  float syst_error_up = up_shape->GetBinContent(i) - nominal_shape->GetBinContent(i);
-                  float syst_error_dn = down_shape->GetBinContent(i) - nominal_shape->GetBinContent(i);
-
-                  //std::cout << "per bin " << syst.name() << " " << syst_error_up << " " << syst_error_dn << std::endl;
-
-                  // Only propagate uncertainties for MC, not signal
-                  if (file.type == MC) {
-                      (*combined_systematics_up)[i - 1] += syst_error_up;
-                      (*combined_systematics_dn)[i - 1] += syst_error_dn;
-
-                      if (i == (uint32_t) stack.syst_only->GetNbinsX()) {
-                          float syst_error_up_over = up_shape->GetBinContent(i+1) - nominal_shape->GetBinContent(i+1);
-                          float syst_error_dn_over = down_shape->GetBinContent(i+1) - nominal_shape->GetBinContent(i+1);
-                          (*combined_systematics_up)[i - 1] += syst_error_up_over;
-                          (*combined_systematics_dn)[i - 1] += syst_error_dn_over;
-                      }
-                  }
-              }
-          }
-      }
-
-      // Combine all systematics in one
-      // Consider that all the systematics are CORRELATED!
-      for (auto& combined_systematics_up: combined_systematics_siglike_map_up) {
-          for (size_t i = 1; i <= (size_t) stack.syst_only->GetNbinsX(); i++) {
-              float total_error_up = stack.syst_siglike_up->GetBinContent(i);
-              stack.syst_siglike_up->SetBinContent(i, total_error_up + combined_systematics_up.second[i-1]);
+              // The overflow is added to the last bin
+              addDifference(nominal.data() + 1, up.data() + 1, n_bins, combined_systematics_siglike_up.data());
+              addDifference(nominal.data() + 1, down.data() + 1, n_bins, combined_systematics_siglike_dn.data());
+              addDifference(nominal.data() + n_bins + 1, up.data() + n_bins + 1, 1, &combined_systematics_siglike_up[n_bins - 1]);
+              addDifference(nominal.data() + n_bins + 1, down.data() + n_bins + 1, 1, &combined_systematics_siglike_dn[n_bins - 1]);
           }
       }
 
-      for (auto& combined_systematics_dn: combined_systematics_siglike_map_dn) {
-          for (size_t i = 1; i <= (size_t) stack.syst_only->GetNbinsX(); i++) {
-              float total_error_down = stack.syst_siglike_dn->GetBinContent(i);
-              stack.syst_siglike_dn->SetBinContent(i, total_error_down + combined_systematics_dn.second[i-1]);
-          }
+      for (size_t i = 1; i <= n_bins; i++) {
+          stack.syst_siglike_up->SetBinContent(i, stack.syst_siglike_up->GetBinContent(i) + combined_systematics_siglike_up[i - 1]);
+          stack.syst_siglike_dn->SetBinContent(i, stack.syst_siglike_dn->GetBinContent(i) + combined_systematics_siglike_dn[i - 1]);
       }
-      //for (size_t i = 0; i < (size_t) stack.syst_only->GetNbinsX(); i++) {
-      //    std::cout << stack.syst_siglike_up->GetBinContent(i) << " " << stack.syst_siglike_dn->GetBinContent(i) << std::endl;
-      //}
   }
 
-  void TH1Plotter::computeSystematics(Stacks& stacks, Summary& summary) {
+  void TH1Plotter::computeSystematics(Stacks& stacks, Summary& summary, const NominalContents& nominal_contents) {
+      Timing::Scope timing(Timing::SYSTEMATICS, "computeSystematics");
+
       for (auto& stack: stacks)
-          computeSystematics(stack.first, stack.second, summary);
+          computeSystematics(stack.first, stack.second, summary, nominal_contents);
   }
 
-  boost::optional<Summary> TH1Plotter::plot(TCanvas& c, Plot& plot) {
-    c.cd();
+  // Rescale and combine the histograms of a plot, and compute its uncertainties. Nothing is drawn
+  std::shared_ptr<TH1Plotter::Prepared> TH1Plotter::prepare(Plot& plot) {
+    Timing::Scope timing("prepare", plot.name);
 
-    Summary global_summary;
+    auto prepared = std::make_shared<Prepared>();
+    prepared->uid = plot.uid;
+
+    Summary& global_summary = prepared->summary;
 
     // Rescale and style histograms
     for (auto& file : m_plotIt.getFiles()) {
@@ -488,25 +445,11 @@ namespace plotIt {
       h->Rebin(plot.rebin);
 
       if (file.type != DATA) {
-        plot.is_rescaled = true;
+        Timing::Scope timing_rescale("rescale", file.path);
 
-        auto generated_events = file.generated_events;
+        plot.is_rescaled = true;
 
-        if (m_plotIt.getConfiguration().generated_events_histogram.length() > 0 and file.generated_events < 0) {
-            //generated_events = - 1.0 if not declared in file yaml
-            std::shared_ptr<TFile> input(TFile::Open(file.path.c_str()));
-            TH1* hevt = dynamic_cast<TH1*>(input->Get(m_plotIt.getConfiguration().generated_events_histogram.c_str()));
-            generated_events = hevt->GetBinContent(m_plotIt.getConfiguration().generated_events_bin);
-        }
-        float factor = file.cross_section * file.branching_ratio / generated_events;
-
-        if (! m_plotIt.getConfiguration().no_lumi_rescaling) {
-          factor *= m_plotIt.getConfiguration().luminosity.at(file.era);
-        }
-
-        if (! CommandLineCfg::get().ignore_scales) {
-          factor *= m_plotIt.getConfiguration().scale * file.scale;
-        }
+        float factor = m_plotIt.getNormalisation(file);
 
         h->Scale(factor);
         if (plot.scale_option.length() > 0)
@@ -541,22 +484,22 @@ namespace plotIt {
 
         global_summary.add(file.type, summary);
 
-        // Update all systematics for this file
+        // Update all systematics for this file. Shapes shared between the sets are only transformed once
+        auto transform = [&factor, &plot](TH1* h) {
+          h->Scale(factor);
+          h->Rebin(plot.rebin);
+          if (plot.scale_option.length() > 0)
+            h->Scale(1.0, plot.scale_option.c_str());
+        };
+
+        SystematicSet::TransformCache cache;
         for (auto& syst: *file.systematics) {
           syst.update();
-
-          syst.scale(factor);
-          syst.rebin(plot.rebin);
-          if (plot.scale_option.length() > 0)
-            syst.scale(1.0, plot.scale_option.c_str());
+          syst.transform(transform, cache);
         }
         for (auto& syst: *file.systematics_siglike) {
           syst.update();
-
-          syst.scale(factor);
-          syst.rebin(plot.rebin);
-          if (plot.scale_option.length() > 0)
-            syst.scale(1.0, plot.scale_option.c_str());
+          syst.transform(transform, cache);
         }
       } else {
         SummaryItem summary;
@@ -567,47 +510,36 @@ namespace plotIt {
       }
 
       // Add overflow to first and last bin if requested
-      if (plot.show_overflow) {
-        addOverflow(h, file.type, plot);
+      if (plot.show_overflow || plot.show_onlyoverflow) {
+        Timing::Scope timing_overflow("overflow", file.path);
 
-        if (file.type != DATA) {
-            for (auto& syst: *file.systematics) {
-                addOverflow(static_cast<TH1*>(syst.nominal_shape.get()), file.type, plot);
-                addOverflow(static_cast<TH1*>(syst.up_shape.get()), file.type, plot);
-                addOverflow(static_cast<TH1*>(syst.down_shape.get()), file.type, plot);
-            }
-            for (auto& syst: *file.systematics_siglike) {
-                addOverflow(static_cast<TH1*>(syst.nominal_shape.get()), file.type, plot);
-                addOverflow(static_cast<TH1*>(syst.up_shape.get()), file.type, plot);
-                addOverflow(static_cast<TH1*>(syst.down_shape.get()), file.type, plot);
-            }
-        }
-      } else if (plot.show_onlyoverflow) {
-        addOnlyOverflow(h, file.type, plot);
+        auto overflow = [this, &file, &plot](TH1* h) {
+          if (plot.show_overflow)
+            addOverflow(h, file.type, plot);
+          else
+            addOnlyOverflow(h, file.type, plot);
+        };
+
+        overflow(h);
 
         if (file.type != DATA) {
+            SystematicSet::TransformCache cache;
             for (auto& syst: *file.systematics) {
-                addOnlyOverflow(static_cast<TH1*>(syst.nominal_shape.get()), file.type, plot);
-                addOnlyOverflow(static_cast<TH1*>(syst.up_shape.get()), file.type, plot);
-                addOnlyOverflow(static_cast<TH1*>(syst.down_shape.get()), file.type, plot);
+                syst.transform(overflow, cache);
             }
             for (auto& syst: *file.systematics_siglike) {
-                addOnlyOverflow(static_cast<TH1*>(syst.nominal_shape.get()), file.type, plot);
-                addOnlyOverflow(static_cast<TH1*>(syst.up_shape.get()), file.type, plot);
-                addOnlyOverflow(static_cast<TH1*>(syst.down_shape.get()), file.type, plot);
+                syst.transform(overflow, cache);
             }
         }
       }
     }
 
-    std::shared_ptr<TH1> h_data;
-    std::string data_drawing_options;
-
-    std::vector<File> signal_files;
+    std::shared_ptr<TH1>& h_data = prepared->h_data;
+    std::string& data_drawing_options = prepared->data_drawing_options;
 
     for (auto& file: m_plotIt.getFiles()) {
       if (file.type == SIGNAL) {
-        signal_files.push_back(file);
+        prepared->signals.push_back(std::make_pair(dynamic_cast<TH1*>(file.object), m_plotIt.getPlotStyle(file)->drawing_options));
       } else if (file.type == DATA) {
         if (! h_data.get()) {
           h_data.reset(dynamic_cast<TH1*>(file.object->Clone()));
@@ -621,7 +553,24 @@ namespace plotIt {
       }
     }
 
-    auto mc_stacks = buildStacks(plot.sort_by_yields);
+    // Building the stacks may modify the nominal histograms. Normalisation-only systematics
+    // are computed from their content as it is now, like the shapes of the other systematics
+    NominalContents nominal_contents;
+    for (auto& file: m_plotIt.getFiles([] (const File& f) { return f.type != DATA; })) {
+      if (std::none_of(file.systematics->begin(), file.systematics->end(), [](const SystematicSet& s) { return s.normalisation_only; }))
+        continue;
+
+      TH1* h = dynamic_cast<TH1*>(file.object);
+      if (! h)
+        continue;
+
+      auto& contents = nominal_contents[&file];
+      contents.resize(h->GetNbinsX() + 2);
+      getBinContents(h, contents.data());
+    }
+
+    Stacks& mc_stacks = prepared->mc_stacks;
+    mc_stacks = buildStacks(plot.sort_by_yields);
 
     if (plot.no_data || ((h_data.get()) && !h_data->GetSumOfWeights()))
       h_data.reset();
@@ -629,9 +578,9 @@ namespace plotIt {
     bool has_data = h_data.get() != nullptr;
     bool has_mc = !mc_stacks.empty();
 
-    bool no_systematics = false;
+    bool& no_systematics = prepared->no_systematics;
 
-    double h_data_integral = 1.0;
+    double& h_data_integral = prepared->h_data_integral;
     if (has_data) {
         h_data_integral = h_data->Integral();
         if (plot.scale_option.length() > 0)
@@ -741,7 +690,63 @@ namespace plotIt {
     }
 
     if (!no_systematics && plot.show_errors) {
-        computeSystematics(mc_stacks, global_summary);
+        computeSystematics(mc_stacks, global_summary, nominal_contents);
+    }
+
+    // Normalise signals. Their maximum is needed for the automatic range of the y axis
+    for (auto& signal: prepared->signals) {
+      TH1* h_sig = signal.first;
+      if (plot.signal_normalize_data and !plot.no_data) {
+        h_sig->Scale(h_data_integral / h_sig->Integral());
+      } else if (plot.signal_normalize_data and plot.no_data) {
+        auto& mc_stack_tmp = mc_stacks.begin()->second;
+        h_sig->Scale(mc_stack_tmp.stat_only.get()->Integral() / h_sig->Integral());
+      }
+
+      prepared->signal_maximum = std::max(prepared->signal_maximum, static_cast<float>(h_sig->GetMaximum()));
+
+      if (plot.scale_option.length() > 0)
+        h_sig->Scale(1.0, plot.scale_option.c_str());
+    }
+
+    return prepared;
+  }
+
+  boost::optional<Summary> TH1Plotter::plot(TCanvas& c, Plot& plot) {
+    Timing::Scope timing("TH1Plotter::plot", plot.name);
+
+    c.cd();
+
+    // The log-x / log-y variants of a plot share their objects: only prepare them once
+    auto files = m_plotIt.getFiles();
+    const TObject* object = (files.begin() != files.end()) ? files.begin()->object : nullptr;
+
+    if (! m_prepared || m_prepared->uid != plot.uid || m_prepared->object != object) {
+      m_prepared = prepare(plot);
+      m_prepared->object = object;
+    }
+
+    Summary global_summary = m_prepared->summary;
+
+    std::shared_ptr<TH1> h_data = m_prepared->h_data;
+    std::string data_drawing_options = m_prepared->data_drawing_options;
+
+    Stacks& mc_stacks = m_prepared->mc_stacks;
+    bool no_systematics = m_prepared->no_systematics;
+
+    bool has_data = h_data.get() != nullptr;
+    bool has_mc = !mc_stacks.empty();
+
+    // A previous variant may have set the range of the shared objects
+    if (has_data) {
+      h_data->GetXaxis()->SetRange();
+      h_data->SetMinimum();
+      h_data->SetMaximum();
+    }
+
+    for (auto& mc_stack: mc_stacks) {
+      mc_stack.second.stack->SetMinimum();
+      mc_stack.second.stack->SetMaximum();
     }
 
     // Store all the histograms to draw, and find the one with the highest maximum
@@ -852,19 +857,8 @@ namespace plotIt {
       else {
         float maxfrac = 0.45;
         float max_sig = 0.0;
-        if ( signal_files.size() > 0 ) {
-          std::vector<float> sigMax;
-          for (File& signal: signal_files) {
-            TH1* h_sig_temp = dynamic_cast<TH1*>(signal.object);
-            //if (plot.signal_normalize_data and !plot.no_data) h_sig_temp->Scale(h_data->Integral()/h_sig_temp->Integral());
-            if (plot.signal_normalize_data and !plot.no_data) h_sig_temp->Scale(h_data_integral/h_sig_temp->Integral());
-            else if (plot.signal_normalize_data and plot.no_data) {
-                auto& mc_stack_tmp = mc_stacks.begin()->second;
-                h_sig_temp->Scale(mc_stack_tmp.stat_only.get()->Integral()/h_sig_temp->Integral());
-            }
-            sigMax.push_back(h_sig_temp->GetMaximum());
-          }
-          max_sig = *std::max_element(sigMax.begin(), sigMax.end());
+        if ( m_prepared->signals.size() > 0 ) {
+          max_sig = m_prepared->signal_maximum;
         }
         auto& mc_stack = mc_stacks.begin()->second;
         float max_mc = 0.0;
@@ -965,27 +959,9 @@ namespace plotIt {
     }
 
     // Then signal
-    for (File& signal: signal_files) {
-      std::string options = m_plotIt.getPlotStyle(signal)->drawing_options + " same";
-      TH1* h_sig_temp = dynamic_cast<TH1*>(signal.object);
-      if (plot.signal_normalize_data and !plot.no_data) {
-        h_sig_temp->Scale(h_data_integral/h_sig_temp->Integral());
-        if (plot.scale_option.length() > 0)
-          h_sig_temp->Scale(1.0, plot.scale_option.c_str());
-        h_sig_temp->Draw(options.c_str());
-      }
-      else if (plot.signal_normalize_data and plot.no_data) {
-        auto& mc_stack_tmp = mc_stacks.begin()->second;
-        h_sig_temp->Scale(mc_stack_tmp.stat_only.get()->Integral()/h_sig_temp->Integral());
-        if (plot.scale_option.length() > 0)
-          h_sig_temp->Scale(1.0, plot.scale_option.c_str());
-        h_sig_temp->Draw(options.c_str());
-      }
-      else {
-        if (plot.scale_option.length() > 0)
-          h_sig_temp->Scale(1.0, plot.scale_option.c_str());
-        h_sig_temp->Draw(options.c_str());
-      }
+    for (auto& signal: m_prepared->signals) {
+      std::string options = signal.second + " same";
+      signal.first->Draw(options.c_str());
     }
 
     // And finally data
@@ -1102,6 +1078,7 @@ namespace plotIt {
     toDraw[0].first->Draw("axis same");
 
     if (plot.show_ratio) {
+      Timing::Scope timing_ratio("ratio");
 
       // Compute ratio and draw it
       low_pad->cd();
@@ -1314,6 +1291,8 @@ namespace plotIt {
       h_low_pad_axis->Draw("same");
 
       if (plot.fit_ratio) {
+        Timing::Scope timing_fit("fit");
+
         float xMin, xMax;
         if (plot.ratio_fit_range.valid()) {
           xMin = plot.ratio_fit_range.start;
@@ -1398,6 +1377,7 @@ namespace plotIt {
     }
 
     if (has_mc && mc_stacks.size() == 1 && plot.fit) {
+      Timing::Scope timing_fit("fit");
 
       auto& mc_stack = mc_stacks.begin()->second;
 
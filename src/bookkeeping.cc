@@ -0,0 +1,231 @@
+#include <bookkeeping.h>
+
+#include <ipc.h>
+#include <timing.h>
+#include <utilities.h>
+
+#include <TBufferFile.h>
+#include <TCanvas.h>
+#include <TDirectory.h>
+#include <TFile.h>
+#include <TList.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace plotIt {
+
+    constexpr std::size_t BookKeeper::batch_size;
+
+    namespace {
+        // Objects drawn on a pad, and on its sub-pads, worth keeping without the canvas
+        void collect_primitives(TVirtualPad* pad, std::vector<TObject*>& primitives) {
+            TIter it(pad->GetListOfPrimitives());
+            TObject* object = nullptr;
+
+            while ((object = it())) {
+                if (object->InheritsFrom("TVirtualPad"))
+                    collect_primitives(static_cast<TVirtualPad*>(object), primitives);
+                else if (object->InheritsFrom("TH1") || object->InheritsFrom("THStack") || object->InheritsFrom("TGraph"))
+                    primitives.push_back(object);
+            }
+        }
+    }
+
+    BookKeeper::~BookKeeper() {
+        close();
+    }
+
+    bool BookKeeper::open(const std::string& path, const std::string& option, Mode mode) {
+        close();
+
+        m_mode = mode;
+        m_failed = false;
+
+        bool started = m_process.start("book-keeping writer", [this, &path, &option](int fd) {
+                m_file.reset(TFile::Open(path.c_str(), option.c_str()));
+                if (m_file) {
+                    run(fd);
+                    m_file->Close();
+                } else {
+                    std::cerr << "Error: cannot open book-keeping file '" << path << "'" << std::endl;
+                    m_failed = true;
+                }
+
+                return ! m_failed;
+            });
+
+        if (started)
+            return true;
+
+        // No writer process: write the objects directly
+        std::cerr << "Warning: cannot start the book-keeping writer process: " << strerror(errno) << std::endl;
+
+        m_file.reset(TFile::Open(path.c_str(), option.c_str()));
+        if (! m_file) {
+            std::cerr << "Error: cannot open book-keeping file '" << path << "'" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    void BookKeeper::add(TCanvas& canvas, const std::string& folder) {
+        Timing::Scope timing("book-keeping", canvas.GetName());
+
+        if (m_mode == CANVAS) {
+            add(canvas, folder, canvas.GetName());
+            return;
+        }
+
+        std::string canvas_folder = folder.empty() ? canvas.GetName() : folder + "/" + canvas.GetName();
+
+        std::vector<TObject*> primitives;
+        collect_primitives(&canvas, primitives);
+
+        std::set<std::string> names;
+        for (std::size_t i = 0; i < primitives.size(); i++) {
+            std::string name = primitives[i]->GetName();
+            if (name.empty() || ! names.insert(name).second) {
+                name += "_" + std::to_string(i);
+                names.insert(name);
+            }
+
+            add(*primitives[i], canvas_folder, name);
+        }
+    }
+
+    void BookKeeper::add(const TObject& object, const std::string& folder, const std::string& name) {
+        if (m_file) {
+            write(folder, name, const_cast<TObject*>(&object));
+            return;
+        }
+
+        if (m_process.fd() < 0)
+            return;
+
+        TBufferFile buffer(TBufferFile::kWrite);
+        buffer.WriteObject(&object);
+
+        Entry entry;
+        entry.folder = folder;
+        entry.name = name;
+        entry.data.assign(buffer.Buffer(), buffer.Buffer() + buffer.Length());
+
+        m_pending.push_back(std::move(entry));
+
+        if (m_pending.size() >= batch_size)
+            flush();
+    }
+
+    // Send the buffered objects to the writer process
+    bool BookKeeper::flush() {
+        int fd = m_process.fd();
+        if (m_pending.empty() || fd < 0)
+            return true;
+
+        uint32_t n_entries = m_pending.size();
+        bool success = writeAll(fd, &n_entries, sizeof(n_entries));
+
+        for (const auto& entry: m_pending) {
+            uint64_t size = entry.data.size();
+
+            success = success &&
+                writeString(fd, entry.folder) &&
+                writeString(fd, entry.name) &&
+                writeAll(fd, &size, sizeof(size)) &&
+                writeAll(fd, entry.data.data(), size);
+        }
+
+        m_pending.clear();
+
+        if (! success) {
+            std::cerr << "Error: the book-keeping writer process is gone" << std::endl;
+            m_failed = true;
+
+            m_process.closePipe();
+        }
+
+        return success;
+    }
+
+    bool BookKeeper::close() {
+        if (m_process.running()) {
+            flush();
+
+            if (! m_process.finish())
+                m_failed = true;
+        }
+
+        if (m_file) {
+            m_file->Close();
+            m_file.reset();
+        }
+
+        m_folders.clear();
+        m_primitives_folders.clear();
+
+        bool success = ! m_failed;
+        m_failed = false;
+
+        return success;
+    }
+
+    // Body of the writer process: write the objects as they come
+    void BookKeeper::run(int fd) {
+        uint32_t n_entries = 0;
+        while (readAll(fd, &n_entries, sizeof(n_entries))) {
+            for (uint32_t i = 0; i < n_entries; i++) {
+                std::string folder;
+                std::string name;
+                uint64_t size = 0;
+
+                if (! readString(fd, folder) || ! readString(fd, name) || ! readAll(fd, &size, sizeof(size))) {
+                    m_failed = true;
+                    return;
+                }
+
+                std::vector<char> data(size);
+                if (size > 0 && ! readAll(fd, data.data(), size)) {
+                    m_failed = true;
+                    return;
+                }
+
+                TBufferFile buffer(TBufferFile::kRead, size, data.data(), false);
+                std::unique_ptr<TObject> object(buffer.ReadObject(TObject::Class()));
+                if (! object) {
+                    std::cerr << "Error: cannot read object '" << name << "' for the book-keeping file" << std::endl;
+                    m_failed = true;
+                    continue;
+                }
+
+                write(folder, name, object.get());
+            }
+        }
+    }
+
+    void BookKeeper::write(const std::string& folder, const std::string& name, TObject* object) {
+        Timing::Scope timing("book-keeping write", folder.empty() ? name : folder + "/" + name);
+
+        TDirectory* root = m_file.get();
+
+        if (! folder.empty()) {
+            auto it = m_folders.find(folder);
+            if (it == m_folders.end()) {
+                root = ::plotIt::getDirectory(m_file.get(), folder);
+                m_folders.emplace(folder, root);
+            } else {
+                root = it->second;
+            }
+        }
+
+        // Remove the primitives stored by a previous run, in case they are not all drawn again
+        if (m_mode == PRIMITIVES && m_primitives_folders.insert(folder).second)
+            root->Delete("*;*");
+
+        root->WriteTObject(object, name.c_str(), "Overwrite");
+    }
+}
@@ -0,0 +1,245 @@
+#include <cache.h>
+
+#include <commandlinecfg.h>
+#include <utilities.h>
+
+#include <TBufferFile.h>
+#include <TFile.h>
+#include <TH1.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = boost::filesystem;
+
+namespace plotIt {
+
+    namespace {
+        const char MAGIC[4] = {'P', 'I', 'H', 'C'};
+        const uint32_t VERSION = 2;
+
+        enum EntryType: uint32_t {
+            MISSING = 0,
+            OBJECT = 1
+        };
+
+        /**
+         * Header of an entry. It's followed by the key, then by the object as serialized
+         * by ROOT, with all its attributes.
+         */
+        struct EntryHeader {
+            char magic[4];
+            uint32_t version;
+            uint32_t type;
+            uint32_t key_size;
+            uint64_t object_size;
+        };
+
+        /**
+         * Read-only mapping of a whole file
+         */
+        class MappedFile {
+            public:
+                MappedFile(const std::string& path) {
+                    int fd = ::open(path.c_str(), O_RDONLY);
+                    if (fd < 0)
+                        return;
+
+                    struct stat st;
+                    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                        void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                        if (data != MAP_FAILED) {
+                            m_data = static_cast<const char*>(data);
+                            m_size = st.st_size;
+                        }
+                    }
+
+                    ::close(fd);
+                }
+
+                ~MappedFile() {
+                    if (m_data)
+                        ::munmap(const_cast<char*>(m_data), m_size);
+                }
+
+                const char* data() const {
+                    return m_data;
+                }
+
+                std::size_t size() const {
+                    return m_size;
+                }
+
+            private:
+                const char* m_data = nullptr;
+                std::size_t m_size = 0;
+        };
+    }
+
+    bool HistogramCache::enabled() const {
+        return ! CommandLineCfg::get().cache_dir.empty();
+    }
+
+    std::string HistogramCache::entryPath(const std::string& path, const std::string& name) {
+        auto it = m_folders.find(path);
+        if (it == m_folders.end()) {
+            std::string folder;
+
+            std::string identity = fileIdentity(path);
+            if (! identity.empty()) {
+                fs::path p(CommandLineCfg::get().cache_dir);
+                p /= hashString(identity);
+
+                boost::system::error_code ec;
+                fs::create_directories(p, ec);
+
+                if (! ec)
+                    folder = p.string();
+            }
+
+            it = m_folders.emplace(path, folder).first;
+        }
+
+        if (it->second.empty())
+            return std::string();
+
+        return it->second + "/" + hashString(name) + ".bin";
+    }
+
+    bool HistogramCache::load(const std::string& path, const std::string& name, std::shared_ptr<TObject>& object) {
+        if (! enabled())
+            return false;
+
+        std::string entry = entryPath(path, name);
+        if (entry.empty())
+            return false;
+
+        MappedFile file(entry);
+        if (file.size() < sizeof(EntryHeader))
+            return false;
+
+        EntryHeader header;
+        std::memcpy(&header, file.data(), sizeof(EntryHeader));
+
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION)
+            return false;
+
+        if (file.size() != sizeof(EntryHeader) + header.key_size + header.object_size)
+            return false;
+
+        const char* key = file.data() + sizeof(EntryHeader);
+        const char* data = key + header.key_size;
+
+        // Entries are named after a hash: make sure it's really the object we're looking for
+        if (std::string(key, header.key_size) != name)
+            return false;
+
+        if (header.type == MISSING) {
+            object.reset();
+            return true;
+        }
+
+        // The buffer is only read from, never adopted
+        TBufferFile buffer(TBufferFile::kRead, header.object_size, const_cast<char*>(data), false);
+        object.reset(buffer.ReadObject(TObject::Class()));
+        if (! object)
+            return false;
+
+        if (TH1* h = dynamic_cast<TH1*>(object.get()))
+            h->SetDirectory(nullptr);
+
+        return true;
+    }
+
+    bool HistogramCache::size(const std::string& path, const std::string& name, double& size) {
+        if (! enabled())
+            return false;
+
+        std::string entry = entryPath(path, name);
+        if (entry.empty())
+            return false;
+
+        struct stat st;
+        if (::stat(entry.c_str(), &st) != 0)
+            return false;
+
+        size = st.st_size;
+
+        return true;
+    }
+
+    void HistogramCache::store(const std::string& path, const std::string& name, const TObject* object) {
+        if (! enabled())
+            return;
+
+        EntryHeader header;
+        std::memset(&header, 0, sizeof(EntryHeader));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.type = MISSING;
+        header.key_size = name.size();
+
+        // Trees are read lazily from their file, they cannot live in a buffer
+        if (object && object->InheritsFrom("TTree"))
+            return;
+
+        TBufferFile buffer(TBufferFile::kWrite);
+        if (object) {
+            buffer.WriteObject(object);
+
+            header.type = OBJECT;
+            header.object_size = buffer.Length();
+        }
+
+        std::string entry = entryPath(path, name);
+        if (entry.empty())
+            return;
+
+        // Several processes may write the same entry: write a private copy, then move it in place
+        std::stringstream tmp;
+        tmp << entry << ".tmp" << ::getpid();
+
+        {
+            std::ofstream out(tmp.str(), std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(EntryHeader));
+            out.write(name.data(), name.size());
+            out.write(buffer.Buffer(), header.object_size);
+
+            if (! out) {
+                std::remove(tmp.str().c_str());
+                return;
+            }
+        }
+
+        if (std::rename(tmp.str().c_str(), entry.c_str()) != 0)
+            std::remove(tmp.str().c_str());
+    }
+
+    bool getCachedObject(const std::string& path, std::shared_ptr<TFile>& handle, std::shared_ptr<KeyIndex>& keys, const std::string& name, std::shared_ptr<TObject>& object) {
+        HistogramCache& cache = HistogramCache::get();
+
+        if (cache.load(path, name, object))
+            return true;
+
+        if (! openRootFile(path, handle, keys)) {
+            std::cout << "Error: cannot open file '" << path << "'" << std::endl;
+            object.reset();
+            return false;
+        }
+
+        object = getObject(*keys, name);
+        cache.store(path, name, object.get());
+
+        return true;
+    }
+}
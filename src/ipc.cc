@@ -0,0 +1,159 @@
+#include <ipc.h>
+
+#include <timing.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace plotIt {
+
+    bool writeAll(int fd, const void* data, std::size_t size) {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t n = ::write(fd, p, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+
+            p += n;
+            size -= n;
+        }
+
+        return true;
+    }
+
+    bool readAll(int fd, void* data, std::size_t size) {
+        char* p = static_cast<char*>(data);
+        while (size > 0) {
+            ssize_t n = ::read(fd, p, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+
+            p += n;
+            size -= n;
+        }
+
+        return true;
+    }
+
+    bool writeString(int fd, const std::string& value) {
+        uint32_t size = value.size();
+        return writeAll(fd, &size, sizeof(size)) && writeAll(fd, value.data(), size);
+    }
+
+    bool readString(int fd, std::string& value) {
+        uint32_t size = 0;
+        if (! readAll(fd, &size, sizeof(size)))
+            return false;
+
+        value.resize(size);
+        return size == 0 || readAll(fd, &value[0], size);
+    }
+
+    HelperProcess::~HelperProcess() {
+        finish();
+    }
+
+    bool HelperProcess::start(const std::string& name, const std::function<bool(int)>& body) {
+        finish();
+
+        m_name = name;
+
+        int fds[2];
+        if (pipe(fds) != 0)
+            return false;
+
+        int timing_fds[2] = {-1, -1};
+        if (Timing::get().tracing() && pipe(timing_fds) != 0)
+            timing_fds[0] = timing_fds[1] = -1;
+
+        // Flush everything, otherwise pending output would be printed by the helper too
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            Timing::get().reset(name);
+
+            ::close(fds[1]);
+            if (timing_fds[0] >= 0)
+                ::close(timing_fds[0]);
+
+            bool success = body(fds[0]);
+            ::close(fds[0]);
+
+            if (timing_fds[1] >= 0) {
+                Timing::get().write(timing_fds[1]);
+                ::close(timing_fds[1]);
+            }
+
+            std::cout.flush();
+            std::cerr.flush();
+            fflush(nullptr);
+            _exit(success ? 0 : 1);
+        }
+
+        int error = errno;
+
+        ::close(fds[0]);
+        if (timing_fds[1] >= 0)
+            ::close(timing_fds[1]);
+
+        if (pid < 0) {
+            ::close(fds[1]);
+            if (timing_fds[0] >= 0)
+                ::close(timing_fds[0]);
+
+            errno = error;
+            return false;
+        }
+
+        m_pid = pid;
+        m_fd = fds[1];
+        m_timing_fd = timing_fds[0];
+        m_previous_sigpipe_handler = signal(SIGPIPE, SIG_IGN);
+
+        return true;
+    }
+
+    void HelperProcess::closePipe() {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    bool HelperProcess::finish() {
+        if (m_pid <= 0)
+            return true;
+
+        closePipe();
+
+        // Nothing to read if the helper failed, which is reported below
+        if (m_timing_fd >= 0) {
+            Timing::get().read(m_timing_fd);
+            ::close(m_timing_fd);
+            m_timing_fd = -1;
+        }
+
+        int status = 0;
+        bool success = waitpid(m_pid, &status, 0) >= 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (! success)
+            std::cerr << "Error: " << m_name << " process " << m_pid << " failed" << std::endl;
+
+        m_pid = -1;
+        signal(SIGPIPE, m_previous_sigpipe_handler);
+
+        return success;
+    }
+}
@@ -0,0 +1,76 @@
+#include <manifest.h>
+
+#include <yaml-cpp/yaml.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+namespace fs = boost::filesystem;
+
+namespace plotIt {
+
+    namespace {
+        const int VERSION = 1;
+    }
+
+    Manifest::Manifest(const std::string& path):
+        m_path(path) {
+
+    }
+
+    bool Manifest::load() {
+        m_outputs.clear();
+
+        if (! fs::exists(m_path))
+            return false;
+
+        try {
+            YAML::Node root = YAML::LoadFile(m_path);
+
+            if (! root["version"] || root["version"].as<int>() != VERSION)
+                return false;
+
+            m_outputs = root["outputs"].as<std::map<std::string, std::string>>();
+        } catch (const YAML::Exception& e) {
+            std::cout << "Warning: cannot read manifest '" << m_path << "': " << e.what() << std::endl;
+            m_outputs.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Manifest::save() const {
+        YAML::Emitter out;
+        out << YAML::BeginMap;
+        out << YAML::Key << "version" << YAML::Value << VERSION;
+        out << YAML::Key << "outputs" << YAML::Value << m_outputs;
+        out << YAML::EndMap;
+
+        // Never leave a truncated manifest behind
+        std::string tmp = m_path + ".tmp";
+        {
+            std::ofstream f(tmp);
+            f << out.c_str() << std::endl;
+
+            if (! f) {
+                std::remove(tmp.c_str());
+                return false;
+            }
+        }
+
+        return std::rename(tmp.c_str(), m_path.c_str()) == 0;
+    }
+
+    bool Manifest::upToDate(const std::string& output, const std::string& hash) const {
+        auto it = m_outputs.find(output);
+        return it != m_outputs.end() && it->second == hash;
+    }
+
+    void Manifest::update(const std::string& output, const std::string& hash) {
+        m_outputs[output] = hash;
+    }
+}
@@ -3,12 +3,19 @@
 // For fnmatch()
 #include <fnmatch.h>
 
+// For fork(), pipe() and waitpid()
+#include <csignal>
+#include <cstring>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include <TROOT.h>
 #include <TList.h>
 #include <TCollection.h>
 #include <TCanvas.h>
 #include <TError.h>
 #include <TFile.h>
+#include <TFileMerger.h>
 #include <TKey.h>
 #include <TLatex.h>
 #include <TLegend.h>
@@ -18,11 +25,14 @@
 #include <TGaxis.h>
 #include <Math/QuantFuncMathCore.h>
 
+#include <algorithm>
+#include <cctype>
 #include <vector>
 #include <map>
 #include <fstream>
 #include <sstream>
 #include <set>
+#include <unordered_set>
 #include <iomanip>
 
 #include "tclap/CmdLine.h"
@@ -32,11 +42,16 @@
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 
+#include <cache.h>
 #include <commandlinecfg.h>
+#include <manifest.h>
 #include <plotters.h>
 #include <pool.h>
+#include <server.h>
 #include <summary.h>
 #include <systematics.h>
+#include <timing.h>
+#include <treefiller.h>
 #include <utilities.h>
 
 
@@ -66,6 +81,10 @@ namespace plotIt {
       TH1::AddDirectory(false);
     }
 
+  plotIt::~plotIt() {
+    destroyPlotters(*this);
+  }
+
   // Replace the "include" fields by the content they point to
   void plotIt::parseIncludes(YAML::Node& node, const fs::path& base) {
 
@@ -139,8 +158,51 @@ namespace plotIt {
             throw YAML::ParserException(node.Mark(), "Invalid systematics node. Must be either a string or a map");
       }
 
-      if (type == "siglike") m_systematics_siglike.push_back(SystematicFactory::create(name, type, configuration));
-      else m_systematics.push_back(SystematicFactory::create(name, type, configuration));
+      auto systematic = SystematicFactory::create(name, type, configuration);
+
+      // Intern the name, so that systematics are indexed by id instead of by name
+      auto id = m_systematics_ids.find(name);
+      if (id == m_systematics_ids.end())
+          id = m_systematics_ids.insert(std::make_pair(name, m_systematics_ids.size())).first;
+      systematic->id = id->second;
+
+      if (type == "siglike") m_systematics_siglike.push_back(systematic);
+      else m_systematics.push_back(systematic);
+  }
+
+  // Match the 'on' pattern of each systematic against the path of each file, once for all the plots
+  void plotIt::findApplicableSystematics() {
+    auto find = [](const File& file, const std::vector<SystematicPtr>& systematics, boost::dynamic_bitset<>& applicable) {
+      applicable.resize(systematics.size());
+      applicable.reset();
+
+      // Data are never affected by systematics
+      if (file.type == DATA)
+        return;
+
+      for (std::size_t i = 0; i < systematics.size(); i++)
+        applicable[i] = std::regex_search(file.path, systematics[i]->on);
+    };
+
+    for (File& file: m_files) {
+      find(file, m_systematics, file.applicable_systematics);
+      find(file, m_systematics_siglike, file.applicable_systematics_siglike);
+    }
+
+    if (CommandLineCfg::get().verbose) {
+      auto print = [](const std::vector<SystematicPtr>& systematics, const boost::dynamic_bitset<>& applicable) {
+        for (auto i = applicable.find_first(); i != boost::dynamic_bitset<>::npos; i = applicable.find_next(i))
+          std::cout << " " << systematics[i]->name;
+      };
+
+      std::cout << "Systematics applied to each file:" << std::endl;
+      for (const File& file: m_files) {
+        std::cout << "  " << file.path << ":";
+        print(m_systematics, file.applicable_systematics);
+        print(m_systematics_siglike, file.applicable_systematics_siglike);
+        std::cout << std::endl;
+      }
+    }
   }
 
   std::vector<RenameOp> parseRenameNode(const YAML::Node& node) {
@@ -153,16 +215,35 @@ namespace plotIt {
 
       for (YAML::const_iterator it = rename_node.begin(); it != rename_node.end(); ++it) {
           const YAML::Node& rename_op_node = *it;
-          RenameOp op;
-          op.from = std::regex(rename_op_node["from"].as<std::string>(), std::regex::extended);
-          op.to = rename_op_node["to"].as<std::string>();
-
-          ops.push_back(op);
+          ops.push_back(makeRenameOp(rename_op_node["from"].as<std::string>(), rename_op_node["to"].as<std::string>()));
       }
 
       return ops;
   }
 
+  std::vector<Label> parseLabelsNode(const YAML::Node& node) {
+    std::vector<Label> labels;
+
+    for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
+      const YAML::Node& labelNode = *it;
+
+      Label label;
+      label.text = labelNode["text"].as<std::string>();
+      label.position = labelNode["position"].as<Point>();
+
+      if (labelNode["size"])
+//        label.size = labelNode["size"].as<uint32_t>();
+        label.size = labelNode["size"].as<float>();
+
+      if (labelNode["font"])
+        label.font = labelNode["font"].as<int>();
+
+      labels.push_back(label);
+    }
+
+    return labels;
+  }
+
   void plotIt::parseFileNode(File& file, const YAML::Node& key, const YAML::Node& value) {
 
       file.path = key.as<std::string>();
@@ -224,7 +305,305 @@ namespace plotIt {
       file.plot_style->loadFromYAML(node, file.type);
   }
 
+  /**
+   * Parse the configuration of a plot, and add it to `plots`, once for each of its log variants
+   */
+  void plotIt::parsePlotNode(const std::string& name, const YAML::Node& node, std::vector<Plot>& plots) {
+    Plot plot;
+
+    plot.name = name;
+
+    plot.config_hash = hashString(plot.name + ": " + YAML::Dump(node));
+    if (node["exclude"])
+      plot.exclude = node["exclude"].as<std::string>();
+
+    if (node["x-axis"])
+      plot.x_axis = node["x-axis"].as<std::string>();
+
+    if (node["y-axis"])
+      plot.y_axis = node["y-axis"].as<std::string>();
+
+    if (node["ratio-y-axis"])
+      plot.ratio_y_axis_title = node["ratio-y-axis"].as<std::string>();
+    else
+      plot.ratio_y_axis_title = m_config.ratio_y_axis_title;
+
+    plot.y_axis_format = m_config.y_axis_format;
+    if (node["y-axis-format"])
+      plot.y_axis_format = node["y-axis-format"].as<std::string>();
+
+    if (node["normalized"])
+      plot.normalized = node["normalized"].as<bool>();
+
+    if (node["signal-normalize-data"])
+      plot.signal_normalize_data = node["signal-normalize-data"].as<bool>();
+
+    if (node["no-data"])
+      plot.no_data = node["no-data"].as<bool>();
+
+    if (node["override"])
+      plot.override = node["override"].as<bool>();
+
+    Log log_y = False;
+    if (node["log-y"]) {
+      log_y = parse_log(node["log-y"]);
+    }
+    if (log_y != Both)
+      plot.log_y = (bool) log_y;
+
+    Log log_x = False;
+    if (node["log-x"]) {
+      log_x = parse_log(node["log-x"]);
+    }
+    if (log_x != Both)
+      plot.log_x = (bool) log_x;
+
+    if (node["save-extensions"])
+      plot.save_extensions = node["save-extensions"].as<std::vector<std::string>>();
+
+    if (node["show-ratio"])
+      plot.show_ratio = node["show-ratio"].as<bool>();
+
+    if (node["fit-ratio"])
+      plot.fit_ratio = node["fit-ratio"].as<bool>();
+
+    if (node["fit"])
+      plot.fit = node["fit"].as<bool>();
+
+    if (node["fit-function"])
+      plot.fit_function = node["fit-function"].as<std::string>();
+
+    if (node["fit-legend"])
+      plot.fit_legend = node["fit-legend"].as<std::string>();
+
+    if (node["fit-legend-position"])
+      plot.fit_legend_position = node["fit-legend-position"].as<Point>();
+
+    if (node["fit-range"])
+      plot.fit_range = node["fit-range"].as<Range>();
+
+    if (node["ratio-fit-function"])
+      plot.ratio_fit_function = node["ratio-fit-function"].as<std::string>();
+
+    if (node["ratio-fit-legend"])
+      plot.ratio_fit_legend = node["ratio-fit-legend"].as<std::string>();
+
+    if (node["ratio-fit-legend-position"])
+      plot.ratio_fit_legend_position = node["ratio-fit-legend-position"].as<Point>();
+
+    if (node["ratio-fit-range"])
+      plot.ratio_fit_range = node["ratio-fit-range"].as<Range>();
+
+    if (node["show-errors"])
+      plot.show_errors = node["show-errors"].as<bool>();
+
+    if (node["x-axis-range"])
+      plot.x_axis_range = node["x-axis-range"].as<Range>();
+    plot.log_x_axis_range = plot.x_axis_range;
+
+    if (node["log-x-axis-range"])
+      plot.log_x_axis_range = node["log-x-axis-range"].as<Range>();
+
+    if (node["y-axis-auto-range"])
+      plot.y_axis_auto_range = node["y-axis-auto-range"].as<bool>();
+
+    if (node["y-axis-range"])
+      plot.y_axis_range = node["y-axis-range"].as<Range>();
+    plot.log_y_axis_range = plot.y_axis_range;
+
+    if (node["log-y-axis-range"])
+      plot.log_y_axis_range = node["log-y-axis-range"].as<Range>();
+
+    if (node["ratio-y-axis-range"])
+      plot.ratio_y_axis_range = node["ratio-y-axis-range"].as<Range>();
+
+    if (node["ratio-y-axis-auto-range"])
+      plot.ratio_y_axis_auto_range = node["ratio-y-axis-auto-range"].as<bool>();
+
+    if (node["ratio-draw-mcstat-error"])
+      plot.ratio_draw_mcstat_error = node["ratio-draw-mcstat-error"].as<bool>();
+
+    if (node["draw-siglike-unc"])
+      plot.draw_siglike_unc = node["draw-siglike-unc"].as<bool>();
+
+    if (node["post-fit"])
+      plot.post_fit = node["post-fit"].as<bool>();
+
+    if (node["blinded-range"])
+      plot.blinded_range = node["blinded-range"].as<Range>();
+
+    if (node["y-axis-show-zero"])
+      plot.y_axis_show_zero = node["y-axis-show-zero"].as<bool>();
+
+    if (node["inherits-from"])
+      plot.inherits_from = node["inherits-from"].as<std::string>();
+
+    if (node["rebin"])
+      plot.rebin = node["rebin"].as<uint16_t>();
+
+    if (node["labels"]) {
+      YAML::Node labels = node["labels"];
+      plot.labels = parseLabelsNode(labels);
+    }
+
+    // Change legend by hand, currently can change only one entry FIXME
+    if (node["change-legend"]) {
+      plot.change_legend = node["change-legend"].as<bool>();
+      plot.legend_name_org = node["legend-name-org"].as<std::string>();
+      plot.legend_name_new = node["legend-name-new"].as<std::string>();
+    }
+
+    if (node["extra-label"])
+      plot.extra_label = node["extra-label"].as<std::string>();
+
+    if (node["legend-position"])
+      plot.legend_position = node["legend-position"].as<Position>();
+    else
+      plot.legend_position = m_legend.position;
+
+    if (node["legend-columns"])
+      plot.legend_columns = node["legend-columns"].as<size_t>();
+    else
+      plot.legend_columns = m_legend.columns;
+
+    if (node["show-overflow"])
+      plot.show_overflow = node["show-overflow"].as<bool>();
+    else if (node["show-onlyoverflow"]) {
+      plot.show_onlyoverflow = node["show-onlyoverflow"].as<bool>();
+      plot.show_overflow = False;
+    } else
+      plot.show_overflow = m_config.show_overflow;
+
+    if (node["errors-type"])
+      plot.errors_type = string_to_errors_type(node["errors-type"].as<std::string>());
+    else
+      plot.errors_type = m_config.errors_type;
+
+    if (node["binning-x"])
+      plot.binning_x = node["binning-x"].as<uint16_t>();
+
+    if (node["binning-y"])
+      plot.binning_y = node["binning-y"].as<uint16_t>();
+
+    if (node["draw-string"])
+      plot.draw_string = node["draw-string"].as<std::string>();
+
+    if (node["selection-string"])
+      plot.selection_string = node["selection-string"].as<std::string>();
+
+    if (node["for-yields"])
+      plot.use_for_yields = node["for-yields"].as<bool>();
+
+    if (node["yields-title"])
+      plot.yields_title = node["yields-title"].as<std::string>();
+    else
+      plot.yields_title = plot.name;
+
+    if (node["yields-table-order"])
+      plot.yields_table_order = node["yields-table-order"].as<int>();
+
+    if (node["vertical-lines"]) {
+      for (const auto& line: node["vertical-lines"]) {
+        plot.lines.push_back(Line(line, VERTICAL));
+      }
+    }
+
+    if (node["horizontal-lines"]) {
+      for (const auto& line: node["horizontal-lines"]) {
+        plot.lines.push_back(Line(line, HORIZONTAL));
+      }
+    }
+
+    if (node["lines"]) {
+      for (const auto& line: node["lines"]) {
+        plot.lines.push_back(Line(line, UNSPECIFIED));
+      }
+    }
+
+    for (auto& line: plot.lines) {
+      if (! line.style)
+        line.style = m_config.line_style;
+    }
+
+    if (node["book-keeping-folder"]) {
+      plot.book_keeping_folder = node["book-keeping-folder"].as<std::string>();
+    }
+
+    plot.renaming_ops = parseRenameNode(node);
+
+    if (node["sort-by-yields"]) {
+      plot.sort_by_yields = node["sort-by-yields"].as<bool>();
+    }
+
+    // Axis size
+    if (node["x-axis-label-size"])
+      plot.x_axis_label_size = node["x-axis-label-size"].as<float>();
+    else
+      plot.x_axis_label_size = m_config.x_axis_label_size;
+
+    if (node["y-axis-label-size"])
+      plot.y_axis_label_size = node["y-axis-label-size"].as<float>();
+    else
+      plot.y_axis_label_size = m_config.y_axis_label_size;
+
+    // Show or hide ticks
+    if (node["x-axis-hide-ticks"])
+      plot.x_axis_hide_ticks = node["x-axis-hide-ticks"].as<bool>();
+
+    if (node["y-axis-hide-ticks"])
+      plot.y_axis_hide_ticks = node["y-axis-hide-ticks"].as<bool>();
+
+    // Additional option for plot scaling
+    if (node["scale-option"])
+      plot.scale_option = node["scale-option"].as<std::string>();
+
+    // Handle log
+    std::vector<bool> logs_x;
+    std::vector<bool> logs_y;
+
+    if (log_x == Both) {
+      logs_x.insert(logs_x.end(), {false, true});
+    } else {
+      logs_x.push_back(plot.log_x);
+    }
+
+    if (log_y == Both) {
+      logs_y.insert(logs_y.end(), {false, true});
+    } else {
+      logs_y.push_back(plot.log_y);
+    }
+
+    // The variants of a plot share their histograms, unless the x axis ranges differ
+    bool same_x_range = (!plot.x_axis_range.valid() && !plot.log_x_axis_range.valid()) || (plot.x_axis_range == plot.log_x_axis_range);
+    std::string log_x_uid = same_x_range ? plot.uid : get_uuid();
+
+    int log_counter(0);
+    for (auto x: logs_x) {
+      for (auto y: logs_y) {
+        Plot p = plot;
+        p.log_x = x;
+        p.log_y = y;
+        if (x && log_x == Both)
+          p.uid = log_x_uid;
+        // If the plot is used for yields, they should be output only once
+        if(log_counter && plot.use_for_yields)
+          p.use_for_yields = false;
+
+        if (p.log_x)
+          p.output_suffix += "_logx";
+
+        if (p.log_y)
+          p.output_suffix += "_logy";
+
+        plots.push_back(p);
+        ++log_counter;
+      }
+    }
+  }
+
   bool plotIt::parseConfigurationFile(const std::string& file, const fs::path& histogramsPath) {
+    Timing::Scope timing("parseConfigurationFile", file);
+
     YAML::Node f;
     try {
       f = YAML::LoadFile(file);
@@ -239,33 +618,18 @@ namespace plotIt {
 
     parseIncludes(f, fs::absolute(fs::path(file)).parent_path());
 
+    // Everything but the plots is shared by all the outputs
+    std::stringstream global_config;
+    for (YAML::const_iterator it = f.begin(); it != f.end(); ++it) {
+      if (it->first.as<std::string>() != "plots")
+        global_config << it->first.as<std::string>() << ": " << YAML::Dump(it->second) << std::endl;
+    }
+    m_config_hash = hashString(global_config.str());
+
     if (! f["files"]) {
       throw YAML::ParserException(YAML::Mark::null_mark(), "Your configuration file must have a 'files' list");
     }
 
-    const auto& parseLabelsNode = [](YAML::Node& node) -> std::vector<Label> {
-      std::vector<Label> labels;
-
-      for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) {
-        const YAML::Node& labelNode = *it;
-
-        Label label;
-        label.text = labelNode["text"].as<std::string>();
-        label.position = labelNode["position"].as<Point>();
-
-        if (labelNode["size"])
-//          label.size = labelNode["size"].as<uint32_t>();
-          label.size = labelNode["size"].as<float>();
-
-        if (labelNode["font"])
-          label.font = labelNode["font"].as<int>();
-
-        labels.push_back(label);
-      }
-
-      return labels;
-    };
-
     // Retrieve legend configuration
     if (f["legend"]) {
       YAML::Node node = f["legend"];
@@ -375,6 +739,9 @@ namespace plotIt {
       if (node["no-lumi-rescaling"])
         m_config.no_lumi_rescaling = node["no-lumi-rescaling"].as<bool>();
 
+      if (node["merge-eras"])
+        m_config.merge_eras = node["merge-eras"].as<bool>();
+
       if (node["luminosity-error"]) {
         float value = node["luminosity-error"].as<float>();
 
@@ -506,6 +873,12 @@ namespace plotIt {
       if (node["book-keeping-file"])
         m_config.book_keeping_file_name = node["book-keeping-file"].as<std::string>();
 
+      if (node["book-keeping-mode"]) {
+        m_config.book_keeping_mode = node["book-keeping-mode"].as<std::string>();
+        if (m_config.book_keeping_mode != "canvas" && m_config.book_keeping_mode != "primitives")
+          throw YAML::ParserException(node["book-keeping-mode"].Mark(), "'book-keeping-mode' must be either 'canvas' or 'primitives'");
+      }
+
       // Axis size
       if (node["x-axis-label-size"])
         m_config.x_axis_label_size = node["x-axis-label-size"].as<float>();
@@ -571,6 +944,9 @@ namespace plotIt {
     if (! expandFiles())
         return false;
 
+    if (! resolveGeneratedEvents())
+        return false;
+
     std::sort(m_files.begin(), m_files.end(), [](const File& a, const File& b) {
       return a.order < b.order;
      });
@@ -633,6 +1009,9 @@ namespace plotIt {
       }
     }
 
+    if (m_config.merge_eras)
+      findMergeableFiles();
+
     // List systematics
     if (f["systematics"]) {
         YAML::Node systs = f["systematics"];
@@ -642,6 +1021,8 @@ namespace plotIt {
         }
     }
 
+    findApplicableSystematics();
+
     // Retrieve plots configuration
     if (! f["plots"]) {
       throw YAML::ParserException(YAML::Mark::null_mark(), "You must specify at least one plot in your configuration file");
@@ -650,290 +1031,10 @@ namespace plotIt {
     YAML::Node plots = f["plots"];
 
     for (YAML::const_iterator it = plots.begin(); it != plots.end(); ++it) {
-      Plot plot;
-
-      plot.name = it->first.as<std::string>();
-
-      YAML::Node node = it->second;
-      if (node["exclude"])
-        plot.exclude = node["exclude"].as<std::string>();
-
-      if (node["x-axis"])
-        plot.x_axis = node["x-axis"].as<std::string>();
-
-      if (node["y-axis"])
-        plot.y_axis = node["y-axis"].as<std::string>();
-
-      if (node["ratio-y-axis"])
-        plot.ratio_y_axis_title = node["ratio-y-axis"].as<std::string>();
-      else
-        plot.ratio_y_axis_title = m_config.ratio_y_axis_title;
-
-      plot.y_axis_format = m_config.y_axis_format;
-      if (node["y-axis-format"])
-        plot.y_axis_format = node["y-axis-format"].as<std::string>();
-
-      if (node["normalized"])
-        plot.normalized = node["normalized"].as<bool>();
-
-      if (node["signal-normalize-data"])
-        plot.signal_normalize_data = node["signal-normalize-data"].as<bool>();
-
-      if (node["no-data"])
-        plot.no_data = node["no-data"].as<bool>();
-
-      if (node["override"])
-        plot.override = node["override"].as<bool>();
-
-      Log log_y = False;
-      if (node["log-y"]) {
-        log_y = parse_log(node["log-y"]);
-      }
-      if (log_y != Both)
-        plot.log_y = (bool) log_y;
-
-      Log log_x = False;
-      if (node["log-x"]) {
-        log_x = parse_log(node["log-x"]);
-      }
-      if (log_x != Both)
-        plot.log_x = (bool) log_x;
-
-      if (node["save-extensions"])
-        plot.save_extensions = node["save-extensions"].as<std::vector<std::string>>();
-
-      if (node["show-ratio"])
-        plot.show_ratio = node["show-ratio"].as<bool>();
-
-      if (node["fit-ratio"])
-        plot.fit_ratio = node["fit-ratio"].as<bool>();
-
-      if (node["fit"])
-        plot.fit = node["fit"].as<bool>();
-
-      if (node["fit-function"])
-        plot.fit_function = node["fit-function"].as<std::string>();
-
-      if (node["fit-legend"])
-        plot.fit_legend = node["fit-legend"].as<std::string>();
-
-      if (node["fit-legend-position"])
-        plot.fit_legend_position = node["fit-legend-position"].as<Point>();
-
-      if (node["fit-range"])
-        plot.fit_range = node["fit-range"].as<Range>();
-
-      if (node["ratio-fit-function"])
-        plot.ratio_fit_function = node["ratio-fit-function"].as<std::string>();
-
-      if (node["ratio-fit-legend"])
-        plot.ratio_fit_legend = node["ratio-fit-legend"].as<std::string>();
-
-      if (node["ratio-fit-legend-position"])
-        plot.ratio_fit_legend_position = node["ratio-fit-legend-position"].as<Point>();
-
-      if (node["ratio-fit-range"])
-        plot.ratio_fit_range = node["ratio-fit-range"].as<Range>();
-
-      if (node["show-errors"])
-        plot.show_errors = node["show-errors"].as<bool>();
-
-      if (node["x-axis-range"])
-        plot.x_axis_range = node["x-axis-range"].as<Range>();
-      plot.log_x_axis_range = plot.x_axis_range;
-
-      if (node["log-x-axis-range"])
-        plot.log_x_axis_range = node["log-x-axis-range"].as<Range>();
-
-      if (node["y-axis-auto-range"])
-        plot.y_axis_auto_range = node["y-axis-auto-range"].as<bool>();
-
-      if (node["y-axis-range"])
-        plot.y_axis_range = node["y-axis-range"].as<Range>();
-      plot.log_y_axis_range = plot.y_axis_range;
-
-      if (node["log-y-axis-range"])
-        plot.log_y_axis_range = node["log-y-axis-range"].as<Range>();
-
-      if (node["ratio-y-axis-range"])
-        plot.ratio_y_axis_range = node["ratio-y-axis-range"].as<Range>();
-
-      if (node["ratio-y-axis-auto-range"])
-        plot.ratio_y_axis_auto_range = node["ratio-y-axis-auto-range"].as<bool>();
-
-      if (node["ratio-draw-mcstat-error"])
-        plot.ratio_draw_mcstat_error = node["ratio-draw-mcstat-error"].as<bool>();
-
-      if (node["draw-siglike-unc"])
-        plot.draw_siglike_unc = node["draw-siglike-unc"].as<bool>();
-
-      if (node["post-fit"])
-        plot.post_fit = node["post-fit"].as<bool>();
-
-      if (node["blinded-range"])
-        plot.blinded_range = node["blinded-range"].as<Range>();
-
-      if (node["y-axis-show-zero"])
-        plot.y_axis_show_zero = node["y-axis-show-zero"].as<bool>();
-
-      if (node["inherits-from"])
-        plot.inherits_from = node["inherits-from"].as<std::string>();
-
-      if (node["rebin"])
-        plot.rebin = node["rebin"].as<uint16_t>();
-
-      if (node["labels"]) {
-        YAML::Node labels = node["labels"];
-        plot.labels = parseLabelsNode(labels);
-      }
-
-      // Change legend by hand, currently can change only one entry FIXME
-      if (node["change-legend"]) {
-        plot.change_legend = node["change-legend"].as<bool>();
-        plot.legend_name_org = node["legend-name-org"].as<std::string>();
-        plot.legend_name_new = node["legend-name-new"].as<std::string>();
-      }
-
-      if (node["extra-label"])
-        plot.extra_label = node["extra-label"].as<std::string>();
-
-      if (node["legend-position"])
-        plot.legend_position = node["legend-position"].as<Position>();
-      else
-        plot.legend_position = m_legend.position;
-
-      if (node["legend-columns"])
-        plot.legend_columns = node["legend-columns"].as<size_t>();
-      else
-        plot.legend_columns = m_legend.columns;
-
-      if (node["show-overflow"])
-        plot.show_overflow = node["show-overflow"].as<bool>();
-      else if (node["show-onlyoverflow"]) {
-        plot.show_onlyoverflow = node["show-onlyoverflow"].as<bool>();
-        plot.show_overflow = False;
-      } else
-        plot.show_overflow = m_config.show_overflow;
-
-      if (node["errors-type"])
-        plot.errors_type = string_to_errors_type(node["errors-type"].as<std::string>());
-      else
-        plot.errors_type = m_config.errors_type;
-
-      if (node["binning-x"])
-        plot.binning_x = node["binning-x"].as<uint16_t>();
-
-      if (node["binning-y"])
-        plot.binning_y = node["binning-y"].as<uint16_t>();
-
-      if (node["draw-string"])
-        plot.draw_string = node["draw-string"].as<std::string>();
-
-      if (node["selection-string"])
-        plot.selection_string = node["selection-string"].as<std::string>();
-
-      if (node["for-yields"])
-        plot.use_for_yields = node["for-yields"].as<bool>();
-
-      if (node["yields-title"])
-        plot.yields_title = node["yields-title"].as<std::string>();
-      else
-        plot.yields_title = plot.name;
-
-      if (node["yields-table-order"])
-        plot.yields_table_order = node["yields-table-order"].as<int>();
-
-      if (node["vertical-lines"]) {
-        for (const auto& line: node["vertical-lines"]) {
-          plot.lines.push_back(Line(line, VERTICAL));
-        }
-      }
-
-      if (node["horizontal-lines"]) {
-        for (const auto& line: node["horizontal-lines"]) {
-          plot.lines.push_back(Line(line, HORIZONTAL));
-        }
-      }
-
-      if (node["lines"]) {
-        for (const auto& line: node["lines"]) {
-          plot.lines.push_back(Line(line, UNSPECIFIED));
-        }
-      }
-
-      for (auto& line: plot.lines) {
-        if (! line.style)
-          line.style = m_config.line_style;
-      }
-
-      if (node["book-keeping-folder"]) {
-        plot.book_keeping_folder = node["book-keeping-folder"].as<std::string>();
-      }
+      std::string name = it->first.as<std::string>();
+      m_plot_nodes[name] = it->second;
 
-      plot.renaming_ops = parseRenameNode(node);
-
-      if (node["sort-by-yields"]) {
-        plot.sort_by_yields = node["sort-by-yields"].as<bool>();
-      }
-
-      // Axis size
-      if (node["x-axis-label-size"])
-        plot.x_axis_label_size = node["x-axis-label-size"].as<float>();
-      else
-        plot.x_axis_label_size = m_config.x_axis_label_size;
-
-      if (node["y-axis-label-size"])
-        plot.y_axis_label_size = node["y-axis-label-size"].as<float>();
-      else
-        plot.y_axis_label_size = m_config.y_axis_label_size;
-
-      // Show or hide ticks
-      if (node["x-axis-hide-ticks"])
-        plot.x_axis_hide_ticks = node["x-axis-hide-ticks"].as<bool>();
-
-      if (node["y-axis-hide-ticks"])
-        plot.y_axis_hide_ticks = node["y-axis-hide-ticks"].as<bool>();
-
-      // Additional option for plot scaling
-      if (node["scale-option"])
-        plot.scale_option = node["scale-option"].as<std::string>();
-
-      // Handle log
-      std::vector<bool> logs_x;
-      std::vector<bool> logs_y;
-
-      if (log_x == Both) {
-        logs_x.insert(logs_x.end(), {false, true});
-      } else {
-        logs_x.push_back(plot.log_x);
-      }
-
-      if (log_y == Both) {
-        logs_y.insert(logs_y.end(), {false, true});
-      } else {
-        logs_y.push_back(plot.log_y);
-      }
-
-      int log_counter(0);
-      for (auto x: logs_x) {
-        for (auto y: logs_y) {
-          Plot p = plot;
-          p.log_x = x;
-          p.log_y = y;
-          // If the plot is used for yields, they should be output only once
-          if(log_counter && plot.use_for_yields)
-            p.use_for_yields = false;
-
-          if (p.log_x)
-            p.output_suffix += "_logx";
-
-          if (p.log_y)
-            p.output_suffix += "_logy";
-
-          m_plots.push_back(p);
-          ++log_counter;
-        }
-      }
+      parsePlotNode(name, it->second, m_plots);
     }
 
     // If at least one plot has 'override' set to true, keep only plots which do
@@ -985,7 +1086,7 @@ namespace plotIt {
       auto getEntries = [&](Type type) {
           std::vector<LegendEntry> entries;
           for (File& file: m_files) {
-              if (file.type == type) {
+              if (file.type == type && ! file.merged) {
                   LegendEntry entry;
                   if (getLegendEntryFromFile(file, entry)) {
                       entries.push_back(entry);
@@ -1085,6 +1186,8 @@ namespace plotIt {
   }
 
   bool plotIt::plot(Plot& plot) {
+    Timing::Scope timing(Timing::DRAW, "plot", plot.name);
+
     std::cout << "Plotting '" << plot.name << "'" << std::endl;
 
     bool hasMC = false;
@@ -1170,10 +1273,6 @@ namespace plotIt {
     if (plot.show_ratio)
       topMargin /= .6666;
 
-    // Move exponent label if shown
-    TGaxis::SetMaxDigits(3);
-    TGaxis::SetExponentOffset(-0.03, 0.01, "y");
-
     // Luminosity label
     if (m_config.lumi_label.length() > 0) {
       std::shared_ptr<TPaveText> pt = std::make_shared<TPaveText>(m_config.margin_left, 1 - 0.2 * topMargin, 1 - m_config.margin_right, 1, "NDC");
@@ -1255,29 +1354,15 @@ namespace plotIt {
     // Ensure path exists
     fs::create_directories(outputName.parent_path());
 
-    for (const std::string& extension: plot.save_extensions) {
-      fs::path plotPathWithExtension = plot_path.replace_extension(extension);
+    {
+      Timing::Scope save_timing(Timing::SAVE);
 
-      std::string finalPlotPathWithExtension = applyRenaming(plot.renaming_ops, plotPathWithExtension.native());
-      fs::path finalOutputName = rootDir / finalPlotPathWithExtension;
+      m_writer.save(c, getOutputs(plot));
 
-      c.SaveAs(finalOutputName.c_str());
-    }
-
-    if (m_config.book_keeping_file) {
-      TDirectory* root = m_config.book_keeping_file.get();
-      if (!plot.book_keeping_folder.empty() || !plot_path.parent_path().empty()) {
-        // Look in the cache if we have this folder. This avoid querying the file each time we save a plot
-        std::string path = (!plot.book_keeping_folder.empty()) ? plot.book_keeping_folder : plot_path.parent_path().string();
-        auto it = m_book_keeping_folders.find(path);
-        if (it == m_book_keeping_folders.end()) {
-          root = ::plotIt::getDirectory(m_config.book_keeping_file.get(), path);
-          m_book_keeping_folders.emplace(path, root);
-        } else {
-          root = it->second;
-        }
-      }
-      root->WriteTObject(&c, nullptr, "Overwrite");
+      if (m_book_keeper.isOpen()) {
+        std::string path = (!plot.book_keeping_folder.empty()) ? plot.book_keeping_folder : plot_path.parent_path().string();
+        m_book_keeper.add(c, path);
+      }
     }
 
     // Clean all temporary resources
@@ -1292,33 +1377,11 @@ namespace plotIt {
   }
 
 
-  // yield table
-  bool plotIt::yields(std::vector<Plot>::iterator plots_begin, std::vector<Plot>::iterator plots_end){
-    std::cout << "Producing LaTeX yield table.\n";
-
-    std::map<std::string, double> data_yields;
-
-    std::map< std::string, std::map<std::string, std::pair<double, double> > > mc_yields;
-    std::map< std::string, double > mc_total;
-    std::map< std::string, double > mc_total_sqerrs;
-    std::set<std::string> mc_processes;
-
-    std::map< std::string, std::map<std::string, std::pair<double, double> > > signal_yields;
-    std::set<std::string> signal_processes;
-
-    std::map<
-        std::tuple<Type, std::string, std::string>, // Type, category, systematics name
-        double
-    > process_systematics;
+  // Gather the numbers needed by the yields and systematics tables from the plots currently loaded
+  bool plotIt::collectYields(std::vector<Plot>::iterator plots_begin, std::vector<Plot>::iterator plots_end, YieldsTable& table, std::size_t first_position) {
+    Timing::Scope timing(Timing::YIELDS);
 
-    std::map<
-        std::string,
-        std::map<Type, double>
-    > total_systematics_squared;
-
-    std::vector< std::pair<int, std::string> > categories;
-
-    bool has_data(false);
+    bool direct = hasDirectYields();
 
     for ( auto it = plots_begin; it != plots_end; ++it ) {
       auto& plot = *it;
@@ -1328,23 +1391,34 @@ namespace plotIt {
       if (plot.yields_title.find("$") == std::string::npos)
           replace_substr(plot.yields_title, "_", "\\_");
 
-      if( std::find_if(categories.begin(), categories.end(), [&](const std::pair<int, std::string> &x){ return x.second == plot.yields_title; }) != categories.end() )
+      if (table.hasCategory(plot.yields_title))
           continue;
-      categories.push_back( std::make_pair(plot.yields_table_order, plot.yields_title) );
+      table.categories.push_back( std::make_pair(plot.yields_table_order, plot.yields_title) );
+      table.category_positions[plot.yields_title] = first_position + (it - plots_begin);
 
-      std::map<std::tuple<Type, std::string>, double> plot_total_systematics;
+      // Sum over the files of each systematic, indexed by systematic id, for each type
+      std::map<Type, std::vector<double>> plot_total_systematics;
+      std::map<Type, std::vector<double>> plot_total_systematics_up;
+      std::map<Type, std::vector<double>> plot_total_systematics_dn;
 
       // Open all files, and find histogram in each
       for (File& file: m_files) {
-        if (! loadObject(file, plot)) {
-          std::cout << "Could not retrieve plot from " << file.path << std::endl;
+        // Already included in the yields of another file
+        if (file.merged)
+          continue;
+
+        ProcessIntegrals integrals;
+        bool found = direct ? integrateFromFile(file, plot, integrals) : integrateLoaded(file, plot, integrals);
+        if (! found) {
+          // Already reported by integrateFromFile, which knows which of the merged files failed
+          if (! direct)
+            std::cout << "Could not retrieve plot from " << file.path << std::endl;
           return false;
         }
 
         if ( file.type == DATA ){
-          TH1* h = dynamic_cast<TH1*>(file.object);
-          data_yields[plot.yields_title] += h->Integral(0, h->GetNbinsX() + 1);
-          has_data = true;
+          table.data_yields[plot.yields_title] += integrals.yield;
+          table.has_data = true;
           continue;
         }
 
@@ -1361,82 +1435,268 @@ namespace plotIt {
             process_name = "$" + process_name + "$";
         }
 
-        std::pair<double, double> yield_sqerror;
-        TH1* hist( dynamic_cast<TH1*>(file.object) );
+        std::pair<double, double> yield_sqerror(integrals.yield, integrals.sqerror);
 
-        if (m_config.generated_events_histogram.length() > 0 and file.generated_events < 0 and file.type != DATA ) {
-            //generated_events = - 1.0 if not declared in file yaml
-            std::shared_ptr<TFile> input(TFile::Open(file.path.c_str()));
-            TH1* hevt = dynamic_cast<TH1*>(input->Get(m_config.generated_events_histogram.c_str()));
-            file.generated_events = hevt->GetBinContent(m_config.generated_events_bin);
+        std::vector<double>& type_total_systematics = plot_total_systematics[file.type];
+        std::vector<double>& type_total_systematics_up = plot_total_systematics_up[file.type];
+        std::vector<double>& type_total_systematics_dn = plot_total_systematics_dn[file.type];
+        if (! integrals.systematics.empty()) {
+          type_total_systematics.resize(getSystematicsCount(), 0.);
+          type_total_systematics_up.resize(getSystematicsCount(), 0.);
+          type_total_systematics_dn.resize(getSystematicsCount(), 0.);
         }
-        double factor = file.cross_section * file.branching_ratio / file.generated_events;
-
-        if (! m_config.no_lumi_rescaling) {
-          factor *= m_config.luminosity.at(file.era);
-        }
-        if (!CommandLineCfg::get().ignore_scales)
-          factor *= m_config.scale * file.scale;
-
-        if (!plot.is_rescaled)
-          hist->Scale(factor);
-
-        for (auto& syst: *file.systematics) {
-          syst.update();
-          syst.scale(factor);
-        }
-
-        // Retrieve yield and stat. error, taking overflow into account
-        yield_sqerror.first = hist->IntegralAndError(0, hist->GetNbinsX() + 1, yield_sqerror.second);
-        yield_sqerror.second = std::pow(yield_sqerror.second, 2);
 
         // Add systematics
         double file_total_systematics = 0;
-        for (auto& syst: *file.systematics) {
-
-          TH1* nominal_shape = static_cast<TH1*>(syst.nominal_shape.get());
-          TH1* up_shape = static_cast<TH1*>(syst.up_shape.get());
-          TH1* down_shape = static_cast<TH1*>(syst.down_shape.get());
+        double file_total_systematics_up = 0;
+        double file_total_systematics_dn = 0;
+        for (const auto& syst: integrals.systematics) {
 
-          if (! nominal_shape || ! up_shape || ! down_shape)
-              continue;
+          double nominal_integral = syst.nominal;
+          double up_integral = syst.up;
+          double down_integral = syst.down;
 
-          double nominal_integral = nominal_shape->Integral(0, nominal_shape->GetNbinsX() + 1);
-          double up_integral = up_shape->Integral(0, up_shape->GetNbinsX() + 1);
-          double down_integral = down_shape->Integral(0, down_shape->GetNbinsX() + 1);
+          // For asym. error, define up/dn separately.
+          // Be careful on the sign
+          double temp_syst_error_up = up_integral - nominal_integral;
+          double temp_syst_error_dn = down_integral - nominal_integral;
 
           double total_syst_error = std::max(
                   std::abs(up_integral - nominal_integral),
                   std::abs(nominal_integral - down_integral)
           );
 
+          double total_syst_error_up;
+          double total_syst_error_dn;
+
+          // Normal case, double-sided
+          if (temp_syst_error_up * temp_syst_error_dn <= 0) {
+            if (temp_syst_error_up >= 0 and temp_syst_error_dn < 0) {
+              total_syst_error_up = temp_syst_error_up;
+              total_syst_error_dn = temp_syst_error_dn;
+            } else {
+              total_syst_error_up = temp_syst_error_dn;
+              total_syst_error_dn = temp_syst_error_up;
+            }
+          }
+          // One-sided.
+          else {
+            if (temp_syst_error_up > 0) {
+                total_syst_error_up = std::max(temp_syst_error_up, temp_syst_error_dn);
+                total_syst_error_dn = 0.0;
+            } else {
+                total_syst_error_up = 0.0;
+                total_syst_error_dn = std::max(temp_syst_error_up, temp_syst_error_dn);
+            }
+          }
+
           file_total_systematics += total_syst_error * total_syst_error;
+          file_total_systematics_up += total_syst_error_up * total_syst_error_up;
+          file_total_systematics_dn += total_syst_error_dn * total_syst_error_dn;
 
-          auto key = std::make_tuple(file.type, syst.name());
-          plot_total_systematics[key] += total_syst_error;
+          type_total_systematics[syst.id] += total_syst_error;
+          type_total_systematics_up[syst.id] += total_syst_error_up;
+          type_total_systematics_dn[syst.id] += total_syst_error_dn;
         }
 
         // file_total_systematics contains the quadratic sum of all the systematics for this file
-        process_systematics[std::make_tuple(file.type, plot.yields_title, process_name)] += std::sqrt(file_total_systematics);
+        auto process_key = std::make_tuple(file.type, plot.yields_title, process_name);
+        table.process_systematics[process_key] += std::sqrt(file_total_systematics);
+        table.process_systematics_up[process_key] += std::sqrt(file_total_systematics_up);
+        table.process_systematics_dn[process_key] += std::sqrt(file_total_systematics_dn);
 
         if ( file.type == MC ){
-          ADD_PAIRS(mc_yields[plot.yields_title][process_name], yield_sqerror);
-          mc_total[plot.yields_title] += yield_sqerror.first;
-          mc_total_sqerrs[plot.yields_title] += yield_sqerror.second;
-          mc_processes.emplace(process_name);
+          ADD_PAIRS(table.mc_yields[plot.yields_title][process_name], yield_sqerror);
+          table.mc_total[plot.yields_title] += yield_sqerror.first;
+          table.mc_total_sqerrs[plot.yields_title] += yield_sqerror.second;
+          table.mc_processes.emplace(process_name);
         }
         if ( file.type == SIGNAL ){
-          ADD_PAIRS(signal_yields[plot.yields_title][process_name], yield_sqerror);
-          signal_processes.emplace(process_name);
+          ADD_PAIRS(table.signal_yields[plot.yields_title][process_name], yield_sqerror);
+          table.signal_processes.emplace(process_name);
         }
       }
 
       // Get the total systematics for this category
-      for (auto& syst: plot_total_systematics) {
-        total_systematics_squared[plot.yields_title][std::get<0>(syst.first)] += syst.second * syst.second;
+      auto add_squares = [&plot](const std::map<Type, std::vector<double>>& systematics, std::map<std::string, std::map<Type, double>>& total) {
+        for (const auto& type: systematics) {
+          if (type.second.empty())
+            continue;
+
+          double& type_total = total[plot.yields_title][type.first];
+          for (double syst: type.second)
+            type_total += syst * syst;
+        }
+      };
+
+      add_squares(plot_total_systematics, table.total_systematics_squared);
+      add_squares(plot_total_systematics_up, table.total_systematics_squared_up);
+      add_squares(plot_total_systematics_dn, table.total_systematics_squared_dn);
+    }
+
+    return true;
+  }
+
+  // Yields-only runs in histogram mode read the integrals straight from the files
+  bool plotIt::hasDirectYields() const {
+    return ! CommandLineCfg::get().do_plots && m_config.mode != "tree";
+  }
+
+  // Integrals of a process from the histograms of the chunk, loaded and merged by processChunk()
+  bool plotIt::integrateLoaded(File& file, Plot& plot, ProcessIntegrals& integrals) {
+    if (! loadObject(file, plot))
+      return false;
+
+    TH1* hist( dynamic_cast<TH1*>(file.object) );
+
+    if ( file.type == DATA ){
+      integrals.yield = hist->Integral(0, hist->GetNbinsX() + 1);
+      return true;
+    }
+
+    double factor = getNormalisation(file);
+
+    if (!plot.is_rescaled)
+      hist->Scale(factor);
+
+    // Shapes shared between the sets are only scaled once
+    SystematicSet::TransformCache cache;
+    for (auto& syst: *file.systematics) {
+      syst.update();
+      syst.transform([factor](TH1* h) { h->Scale(factor); }, cache);
+    }
+
+    // Retrieve yield and stat. error, taking overflow into account
+    double error = 0;
+    integrals.yield = hist->IntegralAndError(0, hist->GetNbinsX() + 1, error);
+    integrals.sqerror = error * error;
+
+    for (auto& syst: *file.systematics) {
+      ProcessIntegrals::Systematic integral;
+      integral.id = syst.id();
+
+      if (syst.normalisation_only) {
+        // No shapes: the variations are the nominal yield scaled by a factor
+        integral.nominal = integrals.yield;
+        integral.up = integral.nominal * syst.up_factor;
+        integral.down = integral.nominal * syst.down_factor;
+      } else {
+        TH1* nominal_shape = static_cast<TH1*>(syst.nominal_shape.get());
+        TH1* up_shape = static_cast<TH1*>(syst.up_shape.get());
+        TH1* down_shape = static_cast<TH1*>(syst.down_shape.get());
+
+        if (! nominal_shape || ! up_shape || ! down_shape)
+          continue;
+
+        integral.nominal = nominal_shape->Integral(0, nominal_shape->GetNbinsX() + 1);
+        integral.up = up_shape->Integral(0, up_shape->GetNbinsX() + 1);
+        integral.down = down_shape->Integral(0, down_shape->GetNbinsX() + 1);
+      }
+
+      integrals.systematics.push_back(integral);
+    }
+
+    return true;
+  }
+
+  /**
+   * Integrals of a process read straight from the files: each histogram is read once, integrated
+   * and released, without any clone. The files merged into this one are added with their own
+   * normalisation, and systematics are correlated between them, as mergeObjects() does.
+   */
+  bool plotIt::integrateFromFile(File& file, Plot& plot, ProcessIntegrals& integrals) {
+    std::vector<File*> members = {&file};
+    for (auto index: file.merged_files)
+      members.push_back(&m_files[index]);
+
+    // Sum of the variations over the files, indexed like m_systematics. A file on which a
+    // systematic does not apply contributes its nominal yield.
+    std::vector<double> up(m_systematics.size(), 0.);
+    std::vector<double> down(m_systematics.size(), 0.);
+    boost::dynamic_bitset<> applicable(m_systematics.size());
+
+    auto integrate = [](const TObject* object) {
+      const TH1* h = static_cast<const TH1*>(object);
+      return h->Integral(0, h->GetNbinsX() + 1);
+    };
+
+    for (File* member: members) {
+      std::shared_ptr<TObject> object;
+      if (! getCachedObject(member->path, member->handle, member->keys, getObjectName(*member, plot.name), object))
+        return false;
+
+      TH1* hist = dynamic_cast<TH1*>(object.get());
+      if (! hist) {
+        std::cout << "Could not retrieve plot from " << member->path << std::endl;
+        return false;
+      }
+
+      if (member->type == DATA) {
+        integrals.yield += hist->Integral(0, hist->GetNbinsX() + 1);
+        continue;
+      }
+
+      double factor = getNormalisation(*member);
+
+      double error = 0;
+      double integral = factor * hist->IntegralAndError(0, hist->GetNbinsX() + 1, error);
+      integrals.yield += integral;
+      integrals.sqerror += factor * factor * error * error;
+
+      for (std::size_t i = 0; i < m_systematics.size(); i++) {
+        if (! member->applicable_systematics.test(i)) {
+          up[i] += integral;
+          down[i] += integral;
+          continue;
+        }
+
+        applicable.set(i);
+
+        ShapeSystematic* shape = dynamic_cast<ShapeSystematic*>(m_systematics[i].get());
+        if (shape) {
+          // Missing variations are the nominal shape
+          std::shared_ptr<TObject> variation = shape->loadVariation(*member, plot, UP);
+          up[i] += variation ? factor * integrate(variation.get()) : integral;
+
+          variation = shape->loadVariation(*member, plot, DOWN);
+          down[i] += variation ? factor * integrate(variation.get()) : integral;
+        } else {
+          SystematicSet set = m_systematics[i]->newSet(cow_ptr<TObject>(), *member, plot);
+          up[i] += set.normalisation_only ? integral * set.up_factor : integral;
+          down[i] += set.normalisation_only ? integral * set.down_factor : integral;
+        }
       }
     }
 
+    for (auto i = applicable.find_first(); i != boost::dynamic_bitset<>::npos; i = applicable.find_next(i)) {
+      ProcessIntegrals::Systematic integral;
+      integral.id = m_systematics[i]->id;
+      integral.nominal = integrals.yield;
+      integral.up = up[i];
+      integral.down = down[i];
+
+      integrals.systematics.push_back(integral);
+    }
+
+    return true;
+  }
+
+  // yield table
+  bool plotIt::yields(YieldsTable& table) {
+    Timing::Scope timing(Timing::YIELDS);
+    std::cout << "Producing LaTeX yield table.\n";
+
+    auto& data_yields = table.data_yields;
+    auto& mc_yields = table.mc_yields;
+    auto& mc_total = table.mc_total;
+    auto& mc_total_sqerrs = table.mc_total_sqerrs;
+    const auto& mc_processes = table.mc_processes;
+    auto& signal_yields = table.signal_yields;
+    const auto& signal_processes = table.signal_processes;
+    auto& total_systematics_squared = table.total_systematics_squared;
+    auto& categories = table.categories;
+    bool has_data = table.has_data;
+
     if( ( !(mc_processes.size()+signal_processes.size()) && !has_data ) || !categories.size() ){
       std::cout << "No processes/data/categories defined\n";
       return false;
@@ -1476,7 +1736,7 @@ namespace plotIt {
     }
 
     // Sort according to user-defined order
-    std::sort(categories.begin(), categories.end(), [](const std::pair<int, std::string>& cat1, const std::pair<int, std::string>& cat2){  return cat1.first < cat2.first; });
+    std::stable_sort(categories.begin(), categories.end(), [](const std::pair<int, std::string>& cat1, const std::pair<int, std::string>& cat2){  return cat1.first < cat2.first; });
 
     std::ostringstream latexString;
     std::string tab("    ");
@@ -1751,215 +2011,21 @@ namespace plotIt {
 
 
   // systematics table
-  bool plotIt::systematics(std::vector<Plot>::iterator plots_begin, std::vector<Plot>::iterator plots_end){
+  bool plotIt::systematics(YieldsTable& table) {
+    Timing::Scope timing(Timing::YIELDS);
     std::cout << "Producing LaTeX systematic table.\n";
 
-    std::map<std::string, double> data_yields;
-
-    std::map< std::string, std::map<std::string, std::pair<double, double> > > mc_yields;
-    std::map< std::string, double > mc_total;
-    std::map< std::string, double > mc_total_sqerrs;
-    std::set<std::string> mc_processes;
-
-    std::map< std::string, std::map<std::string, std::pair<double, double> > > signal_yields;
-    std::set<std::string> signal_processes;
-
-    std::map<
-        std::tuple<Type, std::string, std::string>, // Type, category, systematics name
-        double
-    > process_systematics;
-
-
-    std::map<
-        std::tuple<Type, std::string, std::string>, // Type, category, systematics name
-        double
-    > process_systematics_up;
-
-    std::map<
-        std::tuple<Type, std::string, std::string>, // Type, category, systematics name
-        double
-    > process_systematics_dn;
-
-    std::map<
-        std::string,
-        std::map<Type, double>
-    > total_systematics_squared;
-
-    std::map<
-        std::string,
-        std::map<Type, double>
-    > total_systematics_squared_up;
-
-    std::map<
-        std::string,
-        std::map<Type, double>
-    > total_systematics_squared_dn;
-
-    std::vector< std::pair<int, std::string> > categories;
-
-    bool has_data(false);
-
-    for ( auto it = plots_begin; it != plots_end; ++it ) {
-      auto& plot = *it;
-      if (!plot.use_for_yields)
-        continue;
-
-      if (plot.yields_title.find("$") == std::string::npos)
-          replace_substr(plot.yields_title, "_", "\\_");
-
-      if( std::find_if(categories.begin(), categories.end(), [&](const std::pair<int, std::string> &x){ return x.second == plot.yields_title; }) != categories.end() )
-          continue;
-      categories.push_back( std::make_pair(plot.yields_table_order, plot.yields_title) );
-
-      std::map<std::tuple<Type, std::string>, double> plot_total_systematics;
-      std::map<std::tuple<Type, std::string>, double> plot_total_systematics_up;
-      std::map<std::tuple<Type, std::string>, double> plot_total_systematics_dn;
-
-      // Open all files, and find histogram in each
-      for (auto& file: m_files) {
-        if (! loadObject(file, plot)) {
-          std::cout << "Could not retrieve plot from " << file.path << std::endl;
-          return false;
-        }
-
-        if ( file.type == DATA ){
-          TH1* h = dynamic_cast<TH1*>(file.object);
-          data_yields[plot.yields_title] += h->Integral(0, h->GetNbinsX() + 1);
-          has_data = true;
-          continue;
-        }
-
-        std::string process_name = file.yields_group;
-
-        if (process_name.find("$") == std::string::npos)
-            replace_substr(process_name, "_", "\\_");
-
-        if (process_name.find("#") != std::string::npos) {
-            // We assume it's a ROOT LaTeX string. Enclose the string into $$, and replace
-            // '#' by '\'
-
-            replace_substr(process_name, "#", R"(\)");
-            process_name = "$" + process_name + "$";
-        }
-
-        std::pair<double, double> yield_sqerror;
-        TH1* hist( dynamic_cast<TH1*>(file.object) );
-
-        if (m_config.generated_events_histogram.length() > 0 and file.generated_events < 0 and file.type != DATA ) {
-            //generated_events = - 1.0 if not declared in file yaml
-            std::shared_ptr<TFile> input(TFile::Open(file.path.c_str()));
-            TH1* hevt = dynamic_cast<TH1*>(input->Get(m_config.generated_events_histogram.c_str()));
-            file.generated_events = hevt->GetBinContent(m_config.generated_events_bin);
-        }
-        double factor = file.cross_section * file.branching_ratio / file.generated_events;
-
-        if (! m_config.no_lumi_rescaling) {
-          factor *= m_config.luminosity.at(file.era);
-        }
-        if (!CommandLineCfg::get().ignore_scales)
-          factor *= m_config.scale * file.scale;
-
-        if (!plot.is_rescaled)
-          hist->Scale(factor);
-
-        for (auto& syst: *file.systematics) {
-          syst.update();
-          syst.scale(factor);
-        }
-
-        // Retrieve yield and stat. error, taking overflow into account
-        yield_sqerror.first = hist->IntegralAndError(0, hist->GetNbinsX() + 1, yield_sqerror.second);
-        yield_sqerror.second = std::pow(yield_sqerror.second, 2);
-
-        // Add systematics
-        double file_total_systematics = 0;
-        double file_total_systematics_up = 0;
-        double file_total_systematics_dn = 0;
-        for (auto& syst: *file.systematics) {
-
-          TH1* nominal_shape = static_cast<TH1*>(syst.nominal_shape.get());
-          TH1* up_shape = static_cast<TH1*>(syst.up_shape.get());
-          TH1* down_shape = static_cast<TH1*>(syst.down_shape.get());
-
-          if (! nominal_shape || ! up_shape || ! down_shape)
-              continue;
-
-          double nominal_integral = nominal_shape->Integral(0, nominal_shape->GetNbinsX() + 1);
-          double up_integral = up_shape->Integral(0, up_shape->GetNbinsX() + 1);
-          double down_integral = down_shape->Integral(0, down_shape->GetNbinsX() + 1);
-
-          // For asym. error, define up/dn separately.
-          // Be careful on the sign
-          double temp_syst_error_up = up_integral - nominal_integral;
-          double temp_syst_error_dn = down_integral - nominal_integral;
-
-          double total_syst_error = std::max(
-                  std::abs(up_integral - nominal_integral),
-                  std::abs(nominal_integral - down_integral)
-          );
-
-          double total_syst_error_up;
-          double total_syst_error_dn;
-
-          // Normal case, double-sided
-          if (temp_syst_error_up * temp_syst_error_dn <= 0) {
-            if (temp_syst_error_up >= 0 and temp_syst_error_dn < 0) {
-              total_syst_error_up = temp_syst_error_up;
-              total_syst_error_dn = temp_syst_error_dn;
-            } else {
-              total_syst_error_up = temp_syst_error_dn;
-              total_syst_error_dn = temp_syst_error_up;
-            }
-          }
-          // One-sided.
-          else {
-            if (temp_syst_error_up > 0) {
-                total_syst_error_up = std::max(temp_syst_error_up, temp_syst_error_dn);
-                total_syst_error_dn = 0.0;
-            } else {
-                total_syst_error_up = 0.0;
-                total_syst_error_dn = std::max(temp_syst_error_up, temp_syst_error_dn);
-            }
-          }
-
-          file_total_systematics += total_syst_error * total_syst_error;
-          file_total_systematics_up += total_syst_error_up * total_syst_error_up;
-          file_total_systematics_dn += total_syst_error_dn * total_syst_error_dn;
-
-          auto key = std::make_tuple(file.type, syst.name());
-          plot_total_systematics[key] += total_syst_error;
-          plot_total_systematics_up[key] += total_syst_error_up;
-          plot_total_systematics_dn[key] += total_syst_error_dn;
-        }
-
-        // file_total_systematics contains the quadratic sum of all the systematics for this file
-        process_systematics[std::make_tuple(file.type, plot.yields_title, process_name)] += std::sqrt(file_total_systematics);
-        process_systematics_up[std::make_tuple(file.type, plot.yields_title, process_name)] += std::sqrt(file_total_systematics_up);
-        process_systematics_dn[std::make_tuple(file.type, plot.yields_title, process_name)] += std::sqrt(file_total_systematics_dn);
-
-        if ( file.type == MC ){
-          ADD_PAIRS(mc_yields[plot.yields_title][process_name], yield_sqerror);
-          mc_total[plot.yields_title] += yield_sqerror.first;
-          mc_total_sqerrs[plot.yields_title] += yield_sqerror.second;
-          mc_processes.emplace(process_name);
-        }
-        if ( file.type == SIGNAL ){
-          ADD_PAIRS(signal_yields[plot.yields_title][process_name], yield_sqerror);
-          signal_processes.emplace(process_name);
-        }
-      }
-
-      // Get the total systematics for this category
-      for (auto& syst: plot_total_systematics) {
-        total_systematics_squared[plot.yields_title][std::get<0>(syst.first)] += syst.second * syst.second;
-      }
-      for (auto& syst: plot_total_systematics_up) {
-        total_systematics_squared_up[plot.yields_title][std::get<0>(syst.first)] += syst.second * syst.second;
-      }
-      for (auto& syst: plot_total_systematics_dn) {
-        total_systematics_squared_dn[plot.yields_title][std::get<0>(syst.first)] += syst.second * syst.second;
-      }
-    }
+    auto& mc_yields = table.mc_yields;
+    auto& mc_total = table.mc_total;
+    const auto& mc_processes = table.mc_processes;
+    auto& signal_yields = table.signal_yields;
+    const auto& signal_processes = table.signal_processes;
+    auto& process_systematics_up = table.process_systematics_up;
+    auto& process_systematics_dn = table.process_systematics_dn;
+    auto& total_systematics_squared_up = table.total_systematics_squared_up;
+    auto& total_systematics_squared_dn = table.total_systematics_squared_dn;
+    auto& categories = table.categories;
+    bool has_data = table.has_data;
 
     if( ( !(mc_processes.size()+signal_processes.size()) && !has_data ) || !categories.size() ){
       std::cout << "No processes/data/categories defined\n";
@@ -2000,7 +2066,7 @@ namespace plotIt {
     }
 
     // Sort according to user-defined order
-    std::sort(categories.begin(), categories.end(), [](const std::pair<int, std::string>& cat1, const std::pair<int, std::string>& cat2){  return cat1.first < cat2.first; });
+    std::stable_sort(categories.begin(), categories.end(), [](const std::pair<int, std::string>& cat1, const std::pair<int, std::string>& cat2){  return cat1.first < cat2.first; });
 
     std::ostringstream latexString;
     latexString << std::setiosflags(std::ios_base::fixed);
@@ -2090,9 +2156,17 @@ namespace plotIt {
     return true;
   }
 
+  void plotIt::setUpStyle() {
+    m_style.reset(createStyle(m_config));
+
+    // Move exponent label if shown. Set once for all, before any writer process is started
+    TGaxis::SetMaxDigits(3);
+    TGaxis::SetExponentOffset(-0.03, 0.01, "y");
+  }
+
   void plotIt::plotAll() {
 
-    m_style.reset(createStyle(m_config));
+    setUpStyle();
 
     // First, explode plots to match all glob patterns
 
@@ -2105,124 +2179,676 @@ namespace plotIt {
       }
     }
 
+    // Only produce what changed since the previous run
+    Manifest manifest((m_outputPath / "plotIt.manifest").string());
+    if (! CommandLineCfg::get().force)
+      manifest.load();
+
+    std::string global_hash = getGlobalHash();
+    selectOutdatedPlots(plots, manifest, global_hash);
+
+    if (plots.empty()) {
+      std::cout << "Everything is up to date" << std::endl;
+      return;
+    }
+
+    std::vector<Chunk> chunks;
+    if (! splitInChunks(plots, chunks))
+      return;
+
+    if (CommandLineCfg::get().jobs > 1 && chunks.size() > 1) {
+      if (runWorkers(plots, chunks))
+        updateManifest(plots, manifest, global_hash);
+      return;
+    }
+
     if (!m_config.book_keeping_file_name.empty()) {
       fs::path outputName = m_outputPath / m_config.book_keeping_file_name;
-      m_config.book_keeping_file.reset(TFile::Open(outputName.native().c_str(), "recreate"));
+      m_book_keeper.open(outputName.native(), m_incremental ? "update" : "recreate", getBookKeepingMode());
     }
 
-    constexpr std::size_t plots_per_chunk = 20;
+    if (CommandLineCfg::get().async_write)
+      m_writer.start();
 
-    auto plots_begin = plots.begin();
-    auto plots_end = plots.begin();
-    while ( plots_end != plots.end() ) {
-      plots_begin = plots_end;
-      if ( std::distance(plots_begin, plots.end()) > plots_per_chunk ) {
-        plots_end = plots_begin+plots_per_chunk;
-      } else {
-        plots_end = plots.end();
-      }
+    // Filled by every chunk, and written once all of them are done
+    YieldsTable table;
+    for (const Chunk& chunk: chunks) {
+      if (! processChunk(plots, chunk, table))
+        return;
+    }
 
-      if (CommandLineCfg::get().verbose)
-          std::cout << "Loading plots " << std::distance(plots.begin(), plots_begin) << "-" << std::distance(plots.begin(), plots_end) << " of " << plots.size() << "..." << std::endl;
+    closeFiles();
 
-      for (File& file: m_files) {
-        if (! loadAllObjects(file, plots_begin, plots_end))
-            return;
-      }
+    if (CommandLineCfg::get().do_yields && m_tables_outdated) {
+      plotIt::yields(table);
+    }
 
-      if (CommandLineCfg::get().verbose)
-          std::cout << "done." << std::endl;
+    if (CommandLineCfg::get().do_systematics && m_tables_outdated) {
+      plotIt::systematics(table);
+    }
 
-      if (CommandLineCfg::get().do_plots) {
-        for ( auto it = plots_begin; it != plots_end; ++it ) {
-          plotIt::plot(*it);
+    if (! m_writer.finish() || ! m_book_keeper.close())
+      return;
+
+    updateManifest(plots, manifest, global_hash);
+  }
+
+  BookKeeper::Mode plotIt::getBookKeepingMode() const {
+    return (m_config.book_keeping_mode == "primitives") ? BookKeeper::PRIMITIVES : BookKeeper::CANVAS;
+  }
+
+  // Output files of a plot, one per extension
+  std::vector<fs::path> plotIt::getOutputs(const Plot& plot) const {
+    std::vector<fs::path> outputs;
+
+    fs::path plot_path = plot.name + plot.output_suffix;
+    for (const std::string& extension: plot.save_extensions) {
+      fs::path plotPathWithExtension = plot_path.replace_extension(extension);
+
+      std::string finalPlotPathWithExtension = applyRenaming(plot.renaming_ops, plotPathWithExtension.native());
+      outputs.push_back(m_outputPath / finalPlotPathWithExtension);
+    }
+
+    return outputs;
+  }
+
+  /**
+   * Hash of everything shared by all the outputs: the configuration without the plots,
+   * the command line options changing the outputs, and the input files, including the
+   * files holding shape systematics.
+   */
+  std::string plotIt::getGlobalHash() const {
+    const CommandLineCfg& cfg = CommandLineCfg::get();
+
+    std::stringstream global;
+    global << m_config_hash << "|" << cfg.era << "|" << cfg.ignore_scales << cfg.unblind << cfg.systematicsBreakdown <<
+      cfg.do_qcd << cfg.dyincl << cfg.allSig << cfg.noSig << cfg.desytop << cfg.binned << "|" << cfg.selectSig;
+
+    for (const File& file: m_files) {
+      global << "|" << fileIdentity(file.path);
+
+      fs::path path(file.path);
+      for (const auto& friend_file: glob((path.parent_path() / path.stem()).string() + "__*.root"))
+        global << "|" << fileIdentity(friend_file);
+    }
+
+    return hashString(global.str());
+  }
+
+  std::string plotIt::getPlotHash(const Plot& plot, const std::string& global_hash) const {
+    return hashString(global_hash + "|" + plot.name + plot.output_suffix + "|" + plot.config_hash);
+  }
+
+  /**
+   * Compare the plots with the manifest of the previous run. Plots whose outputs are up to
+   * date are dropped, unless the yields tables changed and need them: they are then loaded,
+   * but not drawn again.
+   */
+  void plotIt::selectOutdatedPlots(std::vector<Plot>& plots, const Manifest& manifest, const std::string& global_hash) {
+    const CommandLineCfg& cfg = CommandLineCfg::get();
+
+    // The book-keeping file holds all the plots: if it's gone, everything is drawn again
+    bool book_keeping_missing = !m_config.book_keeping_file_name.empty() && !fs::exists(m_outputPath / m_config.book_keeping_file_name);
+
+    std::size_t n_up_to_date = 0;
+    std::string tables_hash = global_hash;
+
+    for (Plot& plot: plots) {
+      plot.up_to_date = true;
+
+      if (cfg.do_plots) {
+        plot.up_to_date = !book_keeping_missing && manifest.upToDate(plot.name + plot.output_suffix, getPlotHash(plot, global_hash));
+
+        for (const fs::path& output: getOutputs(plot))
+          plot.up_to_date &= fs::exists(output);
+      }
+
+      n_up_to_date += plot.up_to_date;
+
+      if (plot.use_for_yields)
+        tables_hash = hashString(tables_hash + "|" + plot.name + "|" + plot.config_hash);
+    }
+
+    m_tables_outdated = false;
+    if (cfg.do_yields)
+      m_tables_outdated |= !manifest.upToDate("yields.tex", tables_hash) || !fs::exists(m_outputPath / "yields.tex");
+    if (cfg.do_systematics)
+      m_tables_outdated |= !manifest.upToDate("systematics.tex", tables_hash) || !fs::exists(m_outputPath / "systematics.tex");
+
+    m_tables_hash = tables_hash;
+    m_incremental = n_up_to_date > 0;
+
+    if (cfg.verbose && cfg.do_plots)
+      std::cout << n_up_to_date << " of " << plots.size() << " plots are up to date" << std::endl;
+
+    plots.erase(std::remove_if(plots.begin(), plots.end(), [this](const Plot& plot) {
+          return plot.up_to_date && !(plot.use_for_yields && m_tables_outdated);
+        }), plots.end());
+  }
+
+  // Record the outputs produced by this run
+  void plotIt::updateManifest(const std::vector<Plot>& plots, Manifest& manifest, const std::string& global_hash) {
+    for (const Plot& plot: plots) {
+      if (! plot.up_to_date)
+        manifest.update(plot.name + plot.output_suffix, getPlotHash(plot, global_hash));
+    }
+
+    if (m_tables_outdated) {
+      if (CommandLineCfg::get().do_yields)
+        manifest.update("yields.tex", m_tables_hash);
+
+      if (CommandLineCfg::get().do_systematics)
+        manifest.update("systematics.tex", m_tables_hash);
+    }
+
+    if (! manifest.save())
+      std::cerr << "Warning: cannot write the manifest of this run into " << m_outputPath << std::endl;
+  }
+
+  /**
+   * Estimate the memory used by the histograms of each plot while it's loaded, and group
+   * the plots in chunks fitting in the '--max-memory' budget. With '--jobs', each process
+   * holds its own chunk, so the budget is shared between them.
+   *
+   * In tree mode, histograms are small: all the plots usually fit in a single chunk,
+   * and each tree is read only once.
+   */
+  bool plotIt::splitInChunks(const std::vector<Plot>& plots, std::vector<Chunk>& chunks) {
+
+    // The systematic sets share an untouched copy of the nominal histogram. Each set then holds
+    // up to two loaded variations, and their transformed copies once applied
+    constexpr double copies_per_systematic = 4;
+
+    double budget = CommandLineCfg::get().max_memory * 1024. * 1024. / CommandLineCfg::get().jobs;
+
+    std::vector<std::size_t> n_systematics;
+    for (File& file: m_files) {
+      const auto& applicable = file.applicable_systematics;
+
+      std::size_t n = file.applicable_systematics_siglike.count();
+      for (auto i = applicable.find_first(); i != boost::dynamic_bitset<>::npos; i = applicable.find_next(i)) {
+        // Normalisation-only systematics do not hold any histogram
+        if (dynamic_cast<const ShapeSystematic*>(m_systematics[i].get()))
+          n++;
+      }
+      n_systematics.push_back(n);
+    }
+
+    std::vector<double> chunk_sizes;
+    double chunk_size = 0;
+    std::size_t begin = 0;
+
+    for (std::size_t i = 0; i < plots.size(); i++) {
+      const Plot& plot = plots[i];
+
+      // The variants of a plot share their histograms: keep them in the same chunk
+      if (i > 0 && plot.uid == plots[i - 1].uid)
+        continue;
+
+      double plot_size = 0;
+      for (std::size_t j = 0; j < m_files.size(); j++) {
+        File& file = m_files[j];
+
+        double nominal_size = 0;
+        if (m_config.mode == "tree") {
+          // Bin contents and sum of squares of weights
+          nominal_size = sizeof(TH1F) + (plot.binning_x + 2) * (sizeof(float) + sizeof(double));
+        } else {
+          const std::string& name = getObjectName(file, plot.name);
+
+          // Files are only opened if the histogram is not in the cache
+          if (! HistogramCache::get().size(file.path, name, nominal_size)) {
+            if (! openFile(file)) {
+              std::cout << "Error: cannot open file '" << file.path << "'" << std::endl;
+              return false;
+            }
+
+            auto key = file.keys->find(name);
+            if (key != file.keys->end())
+              nominal_size = key->second->GetObjlen();
+          }
         }
+
+        if (n_systematics[j] > 0)
+          plot_size += nominal_size * (3 + copies_per_systematic * n_systematics[j]);
+        else
+          plot_size += nominal_size;
       }
 
-      if (CommandLineCfg::get().do_yields) {
-        plotIt::yields(plots_begin, plots_end);
+      if (i > begin && chunk_size + plot_size > budget) {
+        chunks.push_back(std::make_pair(begin, i));
+        chunk_sizes.push_back(chunk_size);
+
+        begin = i;
+        chunk_size = 0;
       }
 
-      if (CommandLineCfg::get().do_systematics) {
-        plotIt::systematics(plots_begin, plots_end);
+      chunk_size += plot_size;
+    }
+
+    if (begin < plots.size()) {
+      chunks.push_back(std::make_pair(begin, plots.size()));
+      chunk_sizes.push_back(chunk_size);
+    }
+
+    if (CommandLineCfg::get().verbose) {
+      std::ios_base::fmtflags flags(std::cout.flags());
+      std::streamsize precision = std::cout.precision();
+
+      double peak = 0;
+      for (std::size_t i = 0; i < chunks.size(); i++) {
+        std::cout << "Chunk " << i << ": plots " << chunks[i].first << "-" << chunks[i].second << ", estimated memory " << std::fixed << std::setprecision(1) << chunk_sizes[i] / (1024. * 1024.) << " MB" << std::endl;
+        peak = std::max(peak, chunk_sizes[i]);
       }
+      std::cout << "Estimated peak memory: " << peak / (1024. * 1024.) << " MB (budget: " << budget / (1024. * 1024.) << " MB per process)" << std::endl;
+
+      std::cout.flags(flags);
+      std::cout.precision(precision);
     }
 
+    return true;
+  }
+
+  // Load all the objects of a chunk of plots, draw them, and gather their yields
+  bool plotIt::processChunk(std::vector<Plot>& plots, const Chunk& chunk, YieldsTable& table) {
+
+    auto plots_begin = plots.begin() + chunk.first;
+    auto plots_end = plots.begin() + chunk.second;
+
+    if (CommandLineCfg::get().verbose)
+        std::cout << "Loading plots " << chunk.first << "-" << chunk.second << " of " << plots.size() << "..." << std::endl;
+
+    if (CommandLineCfg::get().verbose)
+        resetPeakMemory();
+
+    TemporaryPool::get().beginChunk();
+
+    // Yields-only runs integrate the histograms straight from the files: nothing to load
+    if (! hasDirectYields()) {
+      Timing::Scope timing(Timing::LOAD);
+
+      for (File& file: m_files) {
+        if (! loadAllObjects(file, plots_begin, plots_end)) {
+          releaseChunk();
+          return false;
+        }
+      }
+
+      if (m_config.merge_eras)
+        mergeFiles(plots_begin, plots_end);
+    }
+
+    if (CommandLineCfg::get().verbose)
+        std::cout << "done." << std::endl;
+
+    if (CommandLineCfg::get().do_plots) {
+      for ( auto it = plots_begin; it != plots_end; ++it ) {
+        if (! it->up_to_date)
+          plotIt::plot(*it);
+      }
+
+      // Histograms are rescaled once for all the variants of a plot
+      std::set<std::string> rescaled;
+      for ( auto it = plots_begin; it != plots_end; ++it ) {
+        if (it->is_rescaled)
+          rescaled.insert(it->uid);
+      }
+      for ( auto it = plots_begin; it != plots_end; ++it ) {
+        it->is_rescaled = rescaled.count(it->uid) > 0;
+      }
+    }
+
+    bool success = true;
+    if (CommandLineCfg::get().do_yields || CommandLineCfg::get().do_systematics) {
+      success = collectYields(plots_begin, plots_end, table, chunk.first);
+    }
+
+    releaseChunk();
+
+    if (CommandLineCfg::get().verbose) {
+      std::ios_base::fmtflags flags(std::cout.flags());
+      std::streamsize precision = std::cout.precision();
+
+      std::cout << "Plots " << chunk.first << "-" << chunk.second << ": peak memory " << std::fixed << std::setprecision(1) << getPeakMemory() / (1024. * 1024.) << " MB" << std::endl;
+
+      std::cout.flags(flags);
+      std::cout.precision(precision);
+    }
+
+    return success;
+  }
+
+  // Release the objects of the plots of a chunk, and everything built from them
+  void plotIt::releaseChunk() {
     for (File& file: m_files) {
-      file.handle.reset();
-      file.friend_handles.clear();
+      file.object = nullptr;
+      file.objects.clear();
+
+      file.systematics = nullptr;
+      file.systematics_siglike = nullptr;
+      file.systematics_cache.clear();
+      file.systematics_cache_siglike.clear();
+    }
+
+    // A new object may get the address of a released one
+    resetPlotters();
+
+    TemporaryPool::get().endChunk();
+  }
+
+  /**
+   * Merge `overrides` into the configuration of the plot named `name` in the configuration file,
+   * and parse it again. The overrides stay for the next calls.
+   */
+  bool plotIt::overridePlot(const std::string& name, const YAML::Node& overrides) {
+    auto node = m_plot_nodes.find(name);
+    if (node == m_plot_nodes.end()) {
+      std::cout << "Error: no plot named '" << name << "' in the configuration" << std::endl;
+      return false;
     }
 
-    if (m_config.book_keeping_file) {
-      m_config.book_keeping_file->Close();
-      m_config.book_keeping_file.reset();
+    if (! overrides.IsMap()) {
+      std::cout << "Error: the overrides of plot '" << name << "' must be a map" << std::endl;
+      return false;
+    }
+
+    YAML::Node merged = YAML::Clone(node->second);
+    for (YAML::const_iterator it = overrides.begin(); it != overrides.end(); ++it)
+      merged[it->first.as<std::string>()] = it->second;
+
+    std::vector<Plot> variants;
+    parsePlotNode(name, merged, variants);
+
+    node->second = merged;
+
+    // The variants replace the previous ones, at the same place
+    auto first = std::find_if(m_plots.begin(), m_plots.end(), [&name](const Plot& plot) { return plot.name == name; });
+    std::size_t position = first - m_plots.begin();
+
+    m_plots.erase(std::remove_if(m_plots.begin(), m_plots.end(), [&name](const Plot& plot) { return plot.name == name; }), m_plots.end());
+    m_plots.insert(m_plots.begin() + std::min(position, m_plots.size()), variants.begin(), variants.end());
+
+    return true;
+  }
+
+  // Each worker writes its own book-keeping file and yields, which are merged by the parent
+  fs::path plotIt::getWorkerOutput(std::size_t worker, const std::string& name) const {
+    fs::path base(name);
+    return m_outputPath / (base.stem().string() + "_worker" + std::to_string(worker) + base.extension().string());
+  }
+
+  // Process the chunks in `--jobs` forked processes. Chunk indices are handed out through a
+  // pipe, so that a worker picks a new chunk as soon as it is done with the previous one.
+  bool plotIt::runWorkers(std::vector<Plot>& plots, const std::vector<Chunk>& chunks) {
+
+    std::size_t n_workers = std::min<std::size_t>(CommandLineCfg::get().jobs, chunks.size());
+
+    if (CommandLineCfg::get().verbose)
+        std::cout << "Processing " << chunks.size() << " chunks of plots with " << n_workers << " processes" << std::endl;
+
+    // Do not share open files with the children
+    closeFiles();
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+      std::cerr << "Error: cannot create pipe: " << strerror(errno) << std::endl;
+      return false;
+    }
+
+    // Flush everything, otherwise pending output would be printed by each child
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+
+    std::vector<pid_t> workers;
+    for (std::size_t worker = 0; worker < n_workers; worker++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        std::cerr << "Error: cannot start worker process: " << strerror(errno) << std::endl;
+        break;
+      }
+
+      if (pid == 0) {
+        close(fds[1]);
+        int status = runWorker(worker, plots, chunks, fds[0]) ? 0 : 1;
+        close(fds[0]);
+
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        _exit(status);
+      }
+
+      workers.push_back(pid);
+    }
+
+    close(fds[0]);
+
+    // A failed worker closes its end of the pipe: report it instead of being killed by SIGPIPE
+    auto previous_handler = signal(SIGPIPE, SIG_IGN);
+    for (uint32_t i = 0; !workers.empty() && i < chunks.size(); i++) {
+      if (write(fds[1], &i, sizeof(i)) != sizeof(i))
+        break;
+    }
+    close(fds[1]);
+    signal(SIGPIPE, previous_handler);
+
+    bool success = workers.size() == n_workers;
+    for (pid_t pid: workers) {
+      int status = 0;
+      if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "Error: worker process " << pid << " failed" << std::endl;
+        success = false;
+      }
+    }
+
+    for (std::size_t worker = 0; worker < workers.size(); worker++) {
+      fs::path timingFile = getWorkerOutput(worker, "timing.txt");
+      if (! fs::exists(timingFile))
+        continue;
+
+      std::ifstream in(timingFile.string());
+      if (! Timing::get().read(in))
+        std::cerr << "Error: cannot read timing from " << timingFile << std::endl;
+      in.close();
+
+      fs::remove(timingFile);
+    }
+
+    YieldsTable table;
+    for (std::size_t worker = 0; worker < workers.size(); worker++) {
+      fs::path yieldsFile = getWorkerOutput(worker, "yields.bin");
+      if (! fs::exists(yieldsFile))
+        continue;
+
+      std::ifstream in(yieldsFile.string(), std::ios::binary);
+      YieldsTable worker_table;
+      if (worker_table.read(in)) {
+        table.merge(worker_table);
+      } else {
+        std::cerr << "Error: cannot read yields from " << yieldsFile << std::endl;
+        success = false;
+      }
+      in.close();
+
+      fs::remove(yieldsFile);
+    }
+
+    if (!m_config.book_keeping_file_name.empty()) {
+      fs::path outputName = m_outputPath / m_config.book_keeping_file_name;
+
+      std::vector<fs::path> inputs;
+      for (std::size_t worker = 0; worker < workers.size(); worker++) {
+        fs::path input = getWorkerOutput(worker, m_config.book_keeping_file_name);
+        if (fs::exists(input))
+          inputs.push_back(input);
+      }
+
+      if (m_incremental) {
+        // Keep the plots of the previous run which were not drawn again
+        std::unique_ptr<TFile> output(TFile::Open(outputName.native().c_str(), "update"));
+        for (const auto& input: inputs) {
+          std::unique_ptr<TFile> f(TFile::Open(input.native().c_str()));
+          if (output && f) {
+            copyObjects(f.get(), output.get());
+          } else {
+            std::cerr << "Error: cannot copy " << input << " into " << outputName << std::endl;
+            success = false;
+          }
+        }
+      } else {
+        TFileMerger merger(false, false);
+        merger.OutputFile(outputName.native().c_str(), "RECREATE");
+
+        for (const auto& input: inputs)
+          merger.AddFile(input.native().c_str(), false);
+
+        if (! merger.Merge()) {
+          std::cerr << "Error: cannot merge book-keeping files into " << outputName << std::endl;
+          success = false;
+        }
+      }
+
+      for (const auto& input: inputs)
+        fs::remove(input);
+    }
+
+    if (! success)
+      return false;
+
+    if (CommandLineCfg::get().do_yields && m_tables_outdated) {
+      plotIt::yields(table);
+    }
+
+    if (CommandLineCfg::get().do_systematics && m_tables_outdated) {
+      plotIt::systematics(table);
+    }
+
+    return true;
+  }
+
+  // Body of a worker process: process chunks until the parent has no more to give
+  bool plotIt::runWorker(std::size_t worker, std::vector<Plot>& plots, const std::vector<Chunk>& chunks, int fd) {
+
+    // The parent already accounts for what was done before the fork
+    Timing::get().reset("worker " + std::to_string(worker));
+
+    if (!m_config.book_keeping_file_name.empty()) {
+      fs::path outputName = getWorkerOutput(worker, m_config.book_keeping_file_name);
+      m_book_keeper.open(outputName.native(), "recreate", getBookKeepingMode());
+    }
+
+    if (CommandLineCfg::get().async_write)
+      m_writer.start();
+
+    YieldsTable table;
+    bool success = true;
+
+    uint32_t chunk = 0;
+    while (read(fd, &chunk, sizeof(chunk)) == sizeof(chunk)) {
+      if (! processChunk(plots, chunks[chunk], table)) {
+        success = false;
+        break;
+      }
+    }
+
+    closeFiles();
+
+    success &= m_writer.finish();
+    success &= m_book_keeper.close();
+
+    if (success && (CommandLineCfg::get().do_yields || CommandLineCfg::get().do_systematics)) {
+      std::ofstream out(getWorkerOutput(worker, "yields.bin").string(), std::ios::binary);
+      table.write(out);
+    }
+
+    if (Timing::get().enabled() || Timing::get().tracing()) {
+      std::ofstream out(getWorkerOutput(worker, "timing.txt").string());
+      Timing::get().write(out);
+    }
+
+    return success;
+  }
+
+  void plotIt::closeFiles() {
+    for (File& file: m_files) {
+      file.keys.reset();
+      file.handle.reset();
+      file.friend_keys.clear();
+      file.friend_handles.clear();
     }
   }
 
   bool plotIt::loadAllObjects(File& file, std::vector<Plot>::const_iterator plots_begin, std::vector<Plot>::const_iterator plots_end) {
+    Timing::Scope timing("loadAllObjects", file.path);
 
     file.object = nullptr;
     file.objects.clear();
+    file.systematics_cache.clear();
+    file.systematics_cache_siglike.clear();
 
     if (m_config.mode == "tree") {
 
-        if (!file.chain.get()) {
-          file.chain.reset(new TChain(m_config.tree_name.c_str()));
-          file.chain->Add(file.path.c_str());
-        }
+        // Book the histograms of all the plots, and fill them in a single pass over the chain
+        TreeFiller filler(m_config.tree_name, file.path);
 
         for ( auto it = plots_begin; it != plots_end; ++it ) {
           const auto& plot = *it;
 
+          // Already booked for another variant of this plot
+          if (file.objects.count(plot.uid))
+            continue;
+
           auto x_axis_range = plot.log_x ? plot.log_x_axis_range : plot.x_axis_range;
 
           std::shared_ptr<TH1> hist(new TH1F((plot.uid + std::to_string(file.id)).c_str(), "", plot.binning_x, x_axis_range.start, x_axis_range.end));
-          hist->SetDirectory(gROOT);
+          hist->SetDirectory(nullptr);
 
-          file.chain->Draw((plot.draw_string + ">>" + plot.uid + std::to_string(file.id)).c_str(), plot.selection_string.c_str());
+          filler.book(hist.get(), plot.draw_string, plot.selection_string);
 
-          hist->SetDirectory(nullptr);
-          
           file.objects.emplace(plot.uid, hist.get());
 
           TemporaryPool::get().addRuntime(hist);
         }
 
+        if (! filler.fill(CommandLineCfg::get().threads)) {
+          std::cout << "Error: cannot fill plots from file '" << file.path << "'" << std::endl;
+          return false;
+        }
+
         return true;
     }
 
-    if (! file.handle)
-      file.handle.reset(TFile::Open(file.path.c_str()));
-    if (! file.handle)
-      return false;
-
-    file.systematics_cache.clear();
-
     for ( auto it = plots_begin; it != plots_end; ++it ) {
       const auto& plot = *it;
 
-      std::string plot_name = plot.name;
+      // Already loaded for another variant of this plot
+      if (file.objects.count(plot.uid))
+        continue;
 
       // Rename plot name according to user's transformations
-      plot_name = applyRenaming(file.renaming_ops, plot_name);
+      const std::string& plot_name = getObjectName(file, plot.name);
 
-      TObject* obj = file.handle->Get(plot_name.c_str());
+      std::shared_ptr<TObject> obj;
+      if (! getCachedObject(file.path, file.handle, file.keys, plot_name, obj))
+        return false;
 
       if (obj) {
-        std::shared_ptr<TObject> cloned_obj(obj->Clone());
-        TemporaryPool::get().addRuntime(cloned_obj);
+        TemporaryPool::get().addRuntime(obj);
 
-        file.objects.emplace(plot.uid, cloned_obj.get());
+        file.objects.emplace(plot.uid, obj.get());
 
         if (file.type != DATA) {
-          for (auto& syst: m_systematics) {
-              if (std::regex_search(file.path, syst->on))
-                  file.systematics_cache[plot.uid].push_back(syst->newSet(cloned_obj.get(), file, plot));
-          }
-          for (auto& syst: m_systematics_siglike) {
-              if (std::regex_search(file.path, syst->on))
-                  file.systematics_cache_siglike[plot.uid].push_back(syst->newSet(cloned_obj.get(), file, plot));
-          }
+          // The loaded object is modified when plotting: all the sets share an untouched copy
+          cow_ptr<TObject> nominal(obj->Clone());
+
+          const auto& applicable = file.applicable_systematics;
+          for (auto i = applicable.find_first(); i != boost::dynamic_bitset<>::npos; i = applicable.find_next(i))
+              file.systematics_cache[plot.uid].push_back(m_systematics[i]->newSet(nominal, file, plot));
+
+          const auto& applicable_siglike = file.applicable_systematics_siglike;
+          for (auto i = applicable_siglike.find_first(); i != boost::dynamic_bitset<>::npos; i = applicable_siglike.find_next(i))
+              file.systematics_cache_siglike[plot.uid].push_back(m_systematics_siglike[i]->newSet(nominal, file, plot));
         }
 
         continue;
@@ -2235,6 +2861,10 @@ namespace plotIt {
     return true;
   }
 
+  bool plotIt::openFile(File& file) {
+    return openRootFile(file.path, file.handle, file.keys);
+  }
+
   bool plotIt::loadObject(File& file, const Plot& plot) {
 
     file.object = nullptr;
@@ -2255,7 +2885,163 @@ namespace plotIt {
     return true;
   }
 
+  // Rescaling factor of the histograms of a file
+  double plotIt::getNormalisation(const File& file) const {
+    double factor = file.cross_section * file.branching_ratio / file.generated_events;
+
+    if (! m_config.no_lumi_rescaling)
+      factor *= m_config.luminosity.at(file.era);
+
+    if (! CommandLineCfg::get().ignore_scales)
+      factor *= m_config.scale * file.scale;
+
+    return factor;
+  }
+
+  /**
+   * Find the MC and signal files describing the same process in different eras. They are
+   * merged into the first one once loaded, so that each process is rescaled, stacked, and
+   * has its systematics computed only once.
+   */
+  void plotIt::findMergeableFiles() {
+    std::map<std::tuple<Type, std::string, std::string, std::string, int64_t>, std::size_t> processes;
+
+    std::size_t n_merged = 0;
+    for (std::size_t i = 0; i < m_files.size(); i++) {
+      File& file = m_files[i];
+      if (file.type == DATA)
+        continue;
+
+      auto process = std::make_tuple(file.type, file.pretty_name, file.legend_group, file.yields_group, file.stack_index);
+      auto it = processes.emplace(process, i);
+      if (it.second)
+        continue;
+
+      m_files[it.first->second].merged_files.push_back(i);
+      file.merged = true;
+      n_merged++;
+    }
+
+    if (CommandLineCfg::get().verbose)
+      std::cout << "Merging " << n_merged << " files into " << processes.size() << " processes" << std::endl;
+  }
+
+  namespace {
+    // Add `h` with weight `weight` to `sum`, created from `h` if needed
+    void add_weighted(std::shared_ptr<TH1>& sum, const TH1* h, double weight) {
+      if (! sum) {
+        sum.reset(static_cast<TH1*>(h->Clone()));
+        sum->SetDirectory(nullptr);
+        sum->Scale(weight);
+      } else {
+        sum->Add(h, weight);
+      }
+    }
+  }
+
+  /**
+   * Merge the histograms of the files found by findMergeableFiles(). Each file is weighted by its
+   * normalisation relative to the first one, which is then rescaled as usual. Systematics with
+   * the same name are fully correlated between the files.
+   */
+  void plotIt::mergeFiles(std::vector<Plot>::const_iterator plots_begin, std::vector<Plot>::const_iterator plots_end) {
+    for (File& file: m_files) {
+      if (file.merged_files.empty())
+        continue;
+
+      double normalisation = getNormalisation(file);
+
+      std::vector<std::pair<File*, double>> members = {std::make_pair(&file, 1.)};
+      for (auto index: file.merged_files)
+        members.push_back(std::make_pair(&m_files[index], getNormalisation(m_files[index]) / normalisation));
+
+      std::set<std::string> merged_uids;
+      for (auto it = plots_begin; it != plots_end; ++it) {
+        if (merged_uids.insert(it->uid).second)
+          mergeObjects(members, *it);
+      }
+    }
+  }
+
+  void plotIt::mergeObjects(const std::vector<std::pair<File*, double>>& members, const Plot& plot) {
+    const std::string& uid = plot.uid;
+
+    std::vector<TH1*> nominals;
+    std::shared_ptr<TH1> merged;
+    for (const auto& member: members) {
+      nominals.push_back(dynamic_cast<TH1*>(member.first->objects.at(uid)));
+      add_weighted(merged, nominals.back(), member.second);
+    }
+
+    // The sets share an untouched copy of the merged histogram
+    cow_ptr<TObject> merged_nominal(std::static_pointer_cast<TObject>(merged));
+
+    auto mergeSets = [&](std::map<std::string, std::vector<SystematicSet>> File::* cache, const std::vector<SystematicPtr>& systematics) {
+      std::vector<SystematicSet> merged_sets;
+
+      for (const auto& syst: systematics) {
+        // Set of this systematic for each file, if any
+        std::vector<const SystematicSet*> sets;
+        for (const auto& member: members) {
+          const auto& file_sets = (member.first->*cache)[uid];
+          auto it = std::find_if(file_sets.begin(), file_sets.end(), [&syst](const SystematicSet& s) { return s.id() == syst->id; });
+          sets.push_back((it != file_sets.end()) ? &*it : nullptr);
+        }
+
+        if (std::all_of(sets.begin(), sets.end(), [](const SystematicSet* s) { return s == nullptr; }))
+          continue;
+
+        // The same normalisation variation everywhere: nothing to merge
+        const SystematicSet* first = sets.front();
+        if (first && std::all_of(sets.begin(), sets.end(), [first](const SystematicSet* s) {
+              return s && s->normalisation_only && first->normalisation_only && s->up_factor == first->up_factor && s->down_factor == first->down_factor;
+            })) {
+          merged_sets.push_back(*first);
+          continue;
+        }
+
+        std::shared_ptr<TH1> up;
+        std::shared_ptr<TH1> down;
+        for (std::size_t i = 0; i < members.size(); i++) {
+          double weight = members[i].second;
+          const SystematicSet* set = sets[i];
+
+          if (! set) {
+            add_weighted(up, nominals[i], weight);
+            add_weighted(down, nominals[i], weight);
+          } else if (set->normalisation_only) {
+            add_weighted(up, nominals[i], weight * set->up_factor);
+            add_weighted(down, nominals[i], weight * set->down_factor);
+          } else {
+            add_weighted(up, static_cast<const TH1*>(set->true_up_shape.get()), weight);
+            add_weighted(down, static_cast<const TH1*>(set->true_down_shape.get()), weight);
+          }
+        }
+
+        SystematicSet set = syst->Systematic::newSet(merged_nominal, *members.front().first, plot);
+        set.true_up_shape = std::static_pointer_cast<TObject>(up);
+        set.true_down_shape = std::static_pointer_cast<TObject>(down);
+
+        merged_sets.push_back(set);
+      }
+
+      for (const auto& member: members)
+        (member.first->*cache).erase(uid);
+
+      (members.front().first->*cache)[uid] = merged_sets;
+    };
+
+    mergeSets(&File::systematics_cache, m_systematics);
+    mergeSets(&File::systematics_cache_siglike, m_systematics_siglike);
+
+    // The histogram of the first file becomes the merged one
+    for (std::size_t i = 1; i < members.size(); i++)
+      nominals.front()->Add(nominals[i], members[i].second);
+  }
+
   bool plotIt::expandFiles() {
+    Timing::Scope timing("expandFiles");
+
     std::vector<File> files;
 
     for (File& file: m_files) {
@@ -2277,6 +3063,40 @@ namespace plotIt {
     return true;
   }
 
+  /**
+   * Read the number of generated events of the simulated files from the
+   * 'generated-events-histogram', unless it's given in the configuration.
+   * This is done only once, instead of for each plot.
+   */
+  bool plotIt::resolveGeneratedEvents() {
+    if (m_config.generated_events_histogram.empty())
+      return true;
+
+    for (File& file: m_files) {
+      //generated_events = - 1.0 if not declared in file yaml
+      if (file.type == DATA || file.generated_events >= 0)
+        continue;
+
+      std::shared_ptr<TObject> object;
+      if (! getCachedObject(file.path, file.handle, file.keys, m_config.generated_events_histogram, object))
+        return false;
+
+      TH1* hevt = dynamic_cast<TH1*>(object.get());
+
+      if (! hevt) {
+        std::cerr << "Error: histogram '" << m_config.generated_events_histogram << "' not found in file '" << file.path << "'" << std::endl;
+        return false;
+      }
+
+      file.generated_events = hevt->GetBinContent(m_config.generated_events_bin);
+
+      if (CommandLineCfg::get().verbose)
+        std::cout << "Generated events for '" << file.path << "': " << file.generated_events << std::endl;
+    }
+
+    return true;
+  }
+
   /**
    * Merge the labels of the global configuration and the current plot.
    * If some are duplicated, only keep the plot label
@@ -2302,7 +3122,15 @@ namespace plotIt {
     return labels;
   }
 
-  void get_directory_content(TDirectory* root, const std::string& prefix, std::vector<std::string>& content) {
+  /**
+   * List the histograms of a directory and of its sub-directories, flattened as paths, in the order
+   * of the keys. Only the keys are listed: no histogram is read, and sub-directories are only read
+   * if they are not in memory yet.
+   *
+   * The same object can be stored multiple time with a different key. The keys with the highest
+   * cycle, the most recent objects, come first: only the first path of each name is kept.
+   */
+  void get_directory_content(TDirectory* root, const std::string& prefix, std::vector<std::string>& content, std::unordered_set<std::string>& seen) {
       TIter it(root->GetListOfKeys());
       TKey* key = nullptr;
 
@@ -2311,11 +3139,13 @@ namespace plotIt {
           std::string cl = key->GetClassName();
 
           if (cl.find("TDirectory") != std::string::npos) {
-              std::string new_prefix = prefix;
-              if (!prefix.empty())
-                  new_prefix += "/";
-              new_prefix += name;
-              get_directory_content(static_cast<TDirectory*>(key->ReadObj()), new_prefix, content);
+              std::string new_prefix = prefix + name + "/";
+              if (! seen.insert(new_prefix).second)
+                  continue;
+
+              TDirectory* directory = root->GetDirectory(name.c_str());
+              if (directory)
+                  get_directory_content(directory, new_prefix, content, seen);
           } else if (cl.find("TH") != std::string::npos) {
               if (name.find("__") != std::string::npos) {
                   // TODO: Maybe we should be a bit less strict and check that the
@@ -2323,21 +3153,81 @@ namespace plotIt {
                   continue;
               }
 
-              std::string new_prefix = prefix;
-              if (!new_prefix.empty())
-                  new_prefix += "/";
-              content.push_back(new_prefix + name);
+              std::string path = prefix + name;
+              if (seen.insert(path).second)
+                  content.push_back(path);
           }
       }
   }
 
+  // Lower-case paths, sorted, with their index in the listing of the file
+  typedef std::vector<std::pair<std::string, std::size_t>> PrefixIndex;
+
+  std::string to_lower(std::string value) {
+      std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+      return value;
+  }
+
+  PrefixIndex index_by_prefix(const std::vector<std::string>& content) {
+      PrefixIndex index;
+      index.reserve(content.size());
+      for (std::size_t i = 0; i < content.size(); i++)
+          index.push_back(std::make_pair(to_lower(content[i]), i));
+
+      std::sort(index.begin(), index.end());
+
+      return index;
+  }
+
+  /**
+   * Indices of the paths which can match a glob pattern, in the order of the listing: the paths
+   * starting with the literal part of the pattern, before the first wildcard. Case is ignored,
+   * as when matching.
+   */
+  std::vector<std::size_t> find_candidates(const PrefixIndex& index, const std::string& pattern) {
+      std::string prefix = to_lower(pattern.substr(0, pattern.find_first_of("*?[\\")));
+
+      std::vector<std::size_t> candidates;
+      auto it = std::lower_bound(index.begin(), index.end(), std::make_pair(prefix, std::size_t(0)));
+      for (; it != index.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+          candidates.push_back(it->second);
+
+      std::sort(candidates.begin(), candidates.end());
+
+      return candidates;
+  }
+
+  /**
+   * Move the variants of each plot (sharing the same uid) next to the first one
+   */
+  void groupVariants(std::vector<Plot>& plots) {
+    std::unordered_map<std::string, std::size_t> first;
+    for (std::size_t i = 0; i < plots.size(); i++)
+      first.emplace(plots[i].uid, i);
+
+    std::stable_sort(plots.begin(), plots.end(), [&first](const Plot& a, const Plot& b) {
+        return first.at(a.uid) < first.at(b.uid);
+      });
+  }
+
   /**
    * Open 'file', and expand all plots
    */
   bool plotIt::expandObjects(File& file, std::vector<Plot>& plots) {
+    Timing::Scope timing(Timing::LOAD, "expandObjects", file.path);
+
     file.object = nullptr;
     plots.clear();
 
+    // The variants of a plot still share their histograms once expanded
+    std::map<std::pair<std::string, std::string>, std::string> uids;
+    auto clone = [&uids](Plot& plot, const std::string& name) {
+        Plot c = plot.Clone(name);
+        c.uid = uids.emplace(std::make_pair(plot.uid, name), c.uid).first->second;
+
+        return c;
+    };
+
     // Optimization. Look if any of the plots have a glob pattern (either *, ? or [)
     // If not, do not iterate of the file to match pattern, it's useless
     std::vector<Plot> glob_plots;
@@ -2345,29 +3235,31 @@ namespace plotIt {
         if ((plot.name.find("*") != std::string::npos) || (plot.name.find("?") != std::string::npos) || (plot.name.find("[") != std::string::npos)) {
             glob_plots.push_back(plot);
         } else {
-            plots.push_back(plot.Clone(plot.name));
+            plots.push_back(clone(plot, plot.name));
         }
     }
 
     if (glob_plots.empty()) {
+        groupVariants(plots);
         return true;
     }
 
-    std::shared_ptr<TFile> input(TFile::Open(file.path.c_str()));
-    if (! input.get())
+    // The file stays open: its keys are indexed once, for the expansion and for loading the plots
+    if (! openFile(file))
       return false;
 
     // Create file structure, flattening any directory
-    TIter root_keys(input->GetListOfKeys());
-
     std::vector<std::string> file_content;
-    get_directory_content(input.get(), "", file_content);
+    std::unordered_set<std::string> seen;
+    get_directory_content(file.handle.get(), "", file_content, seen);
+
+    PrefixIndex index = index_by_prefix(file_content);
 
     for (Plot& plot: glob_plots) {
         bool match = false;
-        std::vector<std::string> matched;
 
-        for (const auto& content: file_content) {
+        for (std::size_t i: find_candidates(index, plot.name)) {
+            const std::string& content = file_content[i];
 
             // Check name
             if (fnmatch(plot.name.c_str(), content.c_str(), FNM_CASEFOLD) == 0) {
@@ -2377,17 +3269,9 @@ namespace plotIt {
                     continue;
                 }
 
-                // The same object can be stored multiple time with a different key
-                // The iterator returns first the object with the highest key, which is the most recent object
-                // Check if we already have a plot with the same exact name
-                if (std::find_if(matched.begin(), matched.end(), [&content](const std::string& p) { return p == content; }) != matched.end()) {
-                    continue;
-                }
-
                 // Got it!
                 match = true;
-                matched.push_back(content);
-                plots.push_back(plot.Clone(content));
+                plots.push_back(clone(plot, content));
             }
         }
 
@@ -2401,6 +3285,8 @@ namespace plotIt {
       return false;
     }
 
+    groupVariants(plots);
+
     return true;
   }
 
@@ -2455,6 +3341,24 @@ int main(int argc, char** argv) {
 
     TCLAP::SwitchArg binnedArg("", "binned", "Draw with 'ttbarsignal' binned samples", cmd, false);
 
+    TCLAP::ValueArg<unsigned int> jobsArg("j", "jobs", "Number of processes used to produce the plots (default: 1)", false, 1, "int", cmd);
+
+    TCLAP::ValueArg<unsigned int> maxMemoryArg("", "max-memory", "Memory budget, in MB, for the histograms loaded at the same time. With --jobs, it is shared between the processes (default: 2048)", false, 2048, "int", cmd);
+
+    TCLAP::SwitchArg forceArg("f", "force", "Produce all the outputs, even those which did not change since the previous run", cmd, false);
+
+    TCLAP::SwitchArg asyncWriteArg("", "async-write", "Write the image files in a separate process, while the next plots are drawn", cmd, false);
+
+    TCLAP::ValueArg<std::string> cacheDirArg("", "cache-dir", "Folder where the histograms read from the input files are cached, to speed up the next runs", false, "", "string", cmd);
+
+    TCLAP::ValueArg<std::string> timingReportArg("", "timing-report", "Write the time spent in each phase (parse, load, systematics, stack, draw, save, yields) to this file, as JSON", false, "", "string", cmd);
+
+    TCLAP::ValueArg<std::string> profileArg("", "profile", "Record the wall-clock and CPU time of each stage, for each plot and each file, to this file, as a Chrome trace", false, "", "string", cmd);
+
+    TCLAP::ValueArg<std::string> serveArg("", "serve", "Keep running, and produce plots and tables on request, sent through this local socket. The configuration and the histograms stay in memory between requests", false, "", "string", cmd);
+
+    TCLAP::ValueArg<unsigned int> threadsArg("", "threads", "Number of threads used to fill the histograms in tree mode (default: 1)", false, 1, "int", cmd);
+
     cmd.parse(argc, argv);
 
     //bool isData = dataArg.isSet();
@@ -2492,12 +3396,43 @@ int main(int argc, char** argv) {
     CommandLineCfg::get().selectSig = selectSigArg.getValue();
     CommandLineCfg::get().desytop = desytopArg.getValue();
     CommandLineCfg::get().binned = binnedArg.getValue();
-
-    plotIt::plotIt p(outputPath);
-    if (!p.parseConfigurationFile(configFileArg.getValue(), histogramsPath))
+    CommandLineCfg::get().jobs = std::max(1u, jobsArg.getValue());
+    CommandLineCfg::get().threads = std::max(1u, threadsArg.getValue());
+    CommandLineCfg::get().max_memory = maxMemoryArg.getValue();
+    CommandLineCfg::get().cache_dir = cacheDirArg.getValue();
+    CommandLineCfg::get().force = forceArg.getValue();
+    CommandLineCfg::get().async_write = asyncWriteArg.getValue();
+
+    if (CommandLineCfg::get().threads > 1)
+      ROOT::EnableThreadSafety();
+
+    if (timingReportArg.isSet())
+      plotIt::Timing::get().enable();
+
+    if (profileArg.isSet())
+      plotIt::Timing::get().enableTrace(profileArg.getValue());
+
+    if (serveArg.isSet()) {
+      // The timing report and the trace cover all the requests, until the server is asked to quit
+      plotIt::Server server(outputPath, configFileArg.getValue(), histogramsPath);
+      if (!server.run(serveArg.getValue()))
         return 1;
+    } else {
+      plotIt::plotIt p(outputPath);
+      {
+        plotIt::Timing::Scope timing(plotIt::Timing::PARSE);
+        if (!p.parseConfigurationFile(configFileArg.getValue(), histogramsPath))
+            return 1;
+      }
 
-    p.plotAll();
+      p.plotAll();
+    }
+
+    if (timingReportArg.isSet() && !plotIt::Timing::get().writeReport(timingReportArg.getValue()))
+      return 1;
+
+    if (!plotIt::Timing::get().writeTrace())
+      return 1;
 
   } catch (TCLAP::ArgException &e) {
     std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
@@ -0,0 +1,379 @@
+#include <server.h>
+
+#include <plotIt.h>
+#include <commandlinecfg.h>
+#include <ipc.h>
+#include <pool.h>
+#include <yields.h>
+
+#include "yaml-cpp/yaml.h"
+
+#include <TObject.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#include <fnmatch.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace plotIt {
+
+    namespace {
+        std::string trim(const std::string& value) {
+            auto begin = value.find_first_not_of(" \t\r");
+            if (begin == std::string::npos)
+                return std::string();
+
+            auto end = value.find_last_not_of(" \t\r");
+            return value.substr(begin, end - begin + 1);
+        }
+    }
+
+    Server::Server(const fs::path& outputPath, const std::string& configFile, const fs::path& histogramsPath):
+        m_outputPath(outputPath), m_configFile(configFile), m_histogramsPath(histogramsPath) {
+
+    }
+
+    Server::~Server() = default;
+
+    std::unique_ptr<plotIt> Server::parse() {
+        std::unique_ptr<plotIt> p(new plotIt(m_outputPath));
+
+        try {
+            if (! p->parseConfigurationFile(m_configFile, m_histogramsPath))
+                return nullptr;
+        } catch (const std::exception& e) {
+            std::cout << "Error: cannot parse '" << m_configFile << "': " << e.what() << std::endl;
+            return nullptr;
+        }
+
+        if (p->m_config.mode == "tree") {
+            std::cout << "Error: only histograms can be served, not trees" << std::endl;
+            return nullptr;
+        }
+
+        p->setUpStyle();
+
+        return p;
+    }
+
+    bool Server::expand() {
+        std::vector<Plot> plots;
+        if (! m_plotIt->expandObjects(m_plotIt->m_files[0], plots))
+            return false;
+
+        m_plots = plots;
+
+        return true;
+    }
+
+    bool Server::run(const std::string& socket_path) {
+
+        m_plotIt = parse();
+        if (! m_plotIt || ! expand())
+            return false;
+
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Error: socket path '" << socket_path << "' is too long" << std::endl;
+            return false;
+        }
+        strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            std::cerr << "Error: cannot create socket: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        // Left over by a previous server. Anything else is most likely a mistake on the command line
+        struct stat st;
+        if (lstat(socket_path.c_str(), &st) == 0) {
+            if (! S_ISSOCK(st.st_mode)) {
+                std::cerr << "Error: '" << socket_path << "' exists and is not a socket" << std::endl;
+                close(fd);
+                return false;
+            }
+
+            unlink(socket_path.c_str());
+        }
+
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 8) != 0) {
+            std::cerr << "Error: cannot listen on '" << socket_path << "': " << strerror(errno) << std::endl;
+            close(fd);
+            return false;
+        }
+
+        // A client leaving early must not stop the server
+        signal(SIGPIPE, SIG_IGN);
+
+        std::cout << "Serving " << m_plots.size() << " plots on '" << socket_path << "'" << std::endl;
+
+        bool quit = false;
+        while (! quit) {
+            int client = accept(fd, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                std::cerr << "Error: cannot accept connection: " << strerror(errno) << std::endl;
+                break;
+            }
+
+            serve(client, quit);
+            close(client);
+        }
+
+        close(fd);
+        unlink(socket_path.c_str());
+
+        return quit;
+    }
+
+    // Answer the requests of a client, one per line, until it leaves
+    void Server::serve(int client, bool& quit) {
+        std::string buffer;
+        char chunk[4096];
+
+        while (! quit) {
+            auto newline = buffer.find('\n');
+            if (newline == std::string::npos) {
+                ssize_t n = read(client, chunk, sizeof(chunk));
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return;
+
+                buffer.append(chunk, n);
+                continue;
+            }
+
+            std::string request = trim(buffer.substr(0, newline));
+            buffer.erase(0, newline + 1);
+
+            if (request.empty())
+                continue;
+
+            std::string response = handle(request, quit) + "\n";
+            if (! writeAll(client, response.data(), response.size()))
+                return;
+        }
+    }
+
+    std::string Server::handle(const std::string& request, bool& quit) {
+        auto start = std::chrono::steady_clock::now();
+
+        auto space = request.find(' ');
+        std::string command = request.substr(0, space);
+        std::string arguments = (space == std::string::npos) ? std::string() : trim(request.substr(space + 1));
+
+        std::string response;
+        try {
+            if (command == "plot" && ! arguments.empty()) {
+                response = plot(arguments);
+            } else if (command == "yields") {
+                response = yields();
+            } else if (command == "override") {
+                response = overridePlot(arguments);
+            } else if (command == "reload") {
+                response = reload();
+            } else if (command == "quit") {
+                quit = true;
+                return "ok";
+            } else {
+                return "error: unknown request '" + request + "'";
+            }
+        } catch (const std::exception& e) {
+            m_plotIt->releaseChunk();
+            return std::string("error: ") + e.what();
+        }
+
+        if (response.compare(0, 2, "ok") != 0)
+            return response;
+
+        auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        std::stringstream result;
+        result << response << " in " << milliseconds << " ms";
+
+        return result.str();
+    }
+
+    std::string Server::plot(const std::string& pattern) {
+        std::vector<Plot> plots;
+        for (const Plot& plot: m_plots) {
+            if (fnmatch(pattern.c_str(), plot.name.c_str(), FNM_CASEFOLD) == 0)
+                plots.push_back(plot);
+        }
+
+        if (plots.empty())
+            return "error: no plot matching '" + pattern + "'";
+
+        if (! load(plots))
+            return "error: cannot load '" + pattern + "'";
+
+        install(plots);
+
+        std::size_t failed = 0;
+        for (Plot& plot: plots) {
+            if (! m_plotIt->plot(plot))
+                failed++;
+        }
+
+        m_plotIt->releaseChunk();
+
+        if (failed)
+            return "error: " + std::to_string(failed) + " of " + std::to_string(plots.size()) + " plots failed";
+
+        return "ok " + std::to_string(plots.size()) + " plots";
+    }
+
+    std::string Server::yields() {
+        // Copies: the titles are escaped while filling the table
+        std::vector<Plot> plots;
+        for (const Plot& plot: m_plots) {
+            if (plot.use_for_yields)
+                plots.push_back(plot);
+        }
+
+        if (plots.empty())
+            return "error: no plot with 'for-yields: true'";
+
+        if (! m_plotIt->hasDirectYields()) {
+            if (! load(plots))
+                return "error: cannot load the plots";
+
+            install(plots);
+        }
+
+        YieldsTable table;
+        bool success = m_plotIt->collectYields(plots.begin(), plots.end(), table);
+
+        m_plotIt->releaseChunk();
+
+        if (! success || ! m_plotIt->yields(table))
+            return "error: cannot produce the yields table";
+
+        if (CommandLineCfg::get().do_systematics && ! m_plotIt->systematics(table))
+            return "error: cannot produce the systematics table";
+
+        return "ok " + std::to_string(table.categories.size()) + " categories";
+    }
+
+    std::string Server::overridePlot(const std::string& arguments) {
+        auto space = arguments.find(' ');
+        if (space == std::string::npos)
+            return "error: expected 'override <name> <yaml>'";
+
+        std::string name = arguments.substr(0, space);
+        YAML::Node overrides = YAML::Load(arguments.substr(space + 1));
+
+        if (! m_plotIt->overridePlot(name, overrides))
+            return "error: cannot override plot '" + name + "'";
+
+        if (! expand())
+            return "error: cannot expand the plots";
+
+        return "ok";
+    }
+
+    std::string Server::reload() {
+        std::unique_ptr<plotIt> p = parse();
+        if (! p)
+            return "error: cannot parse '" + m_configFile + "', keeping the previous configuration";
+
+        std::swap(m_plotIt, p);
+        m_resident.clear();
+
+        if (! expand())
+            return "error: cannot expand the plots";
+
+        return "ok " + std::to_string(m_plots.size()) + " plots";
+    }
+
+    // Read the histograms of the plots which are not in memory yet
+    bool Server::load(const std::vector<Plot>& plots) {
+        std::vector<Plot> missing;
+        std::set<std::string> names;
+        for (const Plot& plot: plots) {
+            if (! m_resident.count(plot.name) && names.insert(plot.name).second)
+                missing.push_back(plot);
+        }
+
+        if (missing.empty())
+            return true;
+
+        plotIt& p = *m_plotIt;
+
+        TemporaryPool::get().beginChunk();
+
+        bool success = true;
+        for (File& file: p.m_files) {
+            if (! p.loadAllObjects(file, missing.begin(), missing.end())) {
+                success = false;
+                break;
+            }
+        }
+
+        if (success && p.m_config.merge_eras)
+            p.mergeFiles(missing.begin(), missing.end());
+
+        if (success) {
+            for (const Plot& plot: missing) {
+                Resident& resident = m_resident[plot.name];
+
+                for (File& file: p.m_files) {
+                    resident.objects.emplace_back(file.objects.at(plot.uid)->Clone());
+                    resident.systematics.push_back(file.systematics_cache[plot.uid]);
+                    resident.systematics_siglike.push_back(file.systematics_cache_siglike[plot.uid]);
+                }
+            }
+        }
+
+        p.releaseChunk();
+
+        return success;
+    }
+
+    // Give the plots their own copy of the resident histograms, modified while drawing. The
+    // systematics sets can be shared: they are rebuilt from their untouched shapes when used.
+    void Server::install(std::vector<Plot>& plots) {
+        plotIt& p = *m_plotIt;
+
+        TemporaryPool::get().beginChunk();
+
+        for (std::size_t i = 0; i < p.m_files.size(); i++) {
+            File& file = p.m_files[i];
+
+            file.objects.clear();
+            file.systematics_cache.clear();
+            file.systematics_cache_siglike.clear();
+
+            for (Plot& plot: plots) {
+                plot.is_rescaled = false;
+
+                if (file.objects.count(plot.uid))
+                    continue;
+
+                const Resident& resident = m_resident.at(plot.name);
+
+                std::shared_ptr<TObject> object(resident.objects[i]->Clone());
+                TemporaryPool::get().addRuntime(object);
+
+                file.objects.emplace(plot.uid, object.get());
+                file.systematics_cache[plot.uid] = resident.systematics[i];
+                file.systematics_cache_siglike[plot.uid] = resident.systematics_siglike[i];
+            }
+        }
+    }
+}
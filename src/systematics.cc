@@ -1,7 +1,9 @@
 #include <systematics.h>
+#include <cache.h>
 #include <types.h>
 #include <utilities.h>
 #include <commandlinecfg.h>
+#include <timing.h>
 
 #include "yaml-cpp/yaml.h"
 
@@ -25,69 +27,78 @@ namespace plotIt {
         parent->apply(*this);
     }
 
-    void SystematicSet::scale(float factor) {
-        if (nominal_shape) {
-            static_cast<TH1*>(nominal_shape.get())->Scale(factor);
-        }
+    namespace {
+        void transform_shape(cow_ptr<TObject>& shape, const std::function<void(TH1*)>& f, SystematicSet::TransformCache& cache) {
+            if (! shape)
+                return;
 
-        if (up_shape) {
-            static_cast<TH1*>(up_shape.get())->Scale(factor);
-        }
+            auto it = cache.find(shape.get());
+            if (it != cache.end()) {
+                shape = it->second;
+                return;
+            }
 
-        if (down_shape) {
-            static_cast<TH1*>(down_shape.get())->Scale(factor);
+            const TObject* original = shape.get();
+            f(static_cast<TH1*>(shape.write()));
+            cache.emplace(original, shape);
         }
     }
 
-    void SystematicSet::scale(float factor, std::string scale_option_syst) {
-        if (nominal_shape) {
-            static_cast<TH1*>(nominal_shape.get())->Scale(factor, scale_option_syst.c_str());
-        }
+    void SystematicSet::transform(const std::function<void(TH1*)>& f, TransformCache& cache) {
+        transform_shape(nominal_shape, f, cache);
+        transform_shape(up_shape, f, cache);
+        transform_shape(down_shape, f, cache);
+    }
 
-        if (up_shape) {
-            static_cast<TH1*>(up_shape.get())->Scale(factor, scale_option_syst.c_str());
-        }
+    void SystematicSet::scale(float factor) {
+        TransformCache cache;
+        transform([factor](TH1* h) { h->Scale(factor); }, cache);
+    }
 
-        if (down_shape) {
-            static_cast<TH1*>(down_shape.get())->Scale(factor, scale_option_syst.c_str());
-        }
+    void SystematicSet::scale(float factor, std::string scale_option_syst) {
+        TransformCache cache;
+        transform([factor, &scale_option_syst](TH1* h) { h->Scale(factor, scale_option_syst.c_str()); }, cache);
     }
 
     void SystematicSet::rebin(size_t factor) {
-        if (nominal_shape) {
-            static_cast<TH1*>(nominal_shape.get())->Rebin(factor);
-        }
-
-        if (up_shape) {
-            static_cast<TH1*>(up_shape.get())->Rebin(factor);
-        }
-
-        if (down_shape) {
-            static_cast<TH1*>(down_shape.get())->Rebin(factor);
-        }
+        TransformCache cache;
+        transform([factor](TH1* h) { h->Rebin(factor); }, cache);
     }
 
-    std::string SystematicSet::name() const {
+    const std::string& SystematicSet::name() const {
         return parent->name;
     }
 
-    std::string SystematicSet::prettyName() const {
+    const std::string& SystematicSet::prettyName() const {
         return parent->pretty_name;
     }
 
-    SystematicSet Systematic::newSet(TObject* nominal, File& file, const Plot& plot) {
+    std::size_t SystematicSet::id() const {
+        return parent->id;
+    }
+
+    SystematicSet Systematic::newSet(const cow_ptr<TObject>& nominal, File& file, const Plot& plot) {
+        SystematicSet s = SystematicSet(*this);
+        s.true_nominal_shape = nominal;
+        s.true_up_shape = nominal;
+        s.true_down_shape = nominal;
+
+        return s;
+    }
+
+    SystematicSet Systematic::newNormalisationSet(float up, float down) {
         SystematicSet s = SystematicSet(*this);
-        s.true_nominal_shape.reset(nominal->Clone());
-        s.true_up_shape.reset(nominal->Clone());
-        s.true_down_shape.reset(nominal->Clone());
+        s.normalisation_only = true;
+        s.up_factor = up;
+        s.down_factor = down;
 
         return s;
     }
 
     void Systematic::apply(SystematicSet& systs) {
-        systs.nominal_shape.reset(systs.true_nominal_shape->Clone());
-        systs.up_shape.reset(systs.true_up_shape->Clone());
-        systs.down_shape.reset(systs.true_down_shape->Clone());
+        systs.nominal_shape = systs.true_nominal_shape;
+        systs.up_shape = systs.true_up_shape;
+        systs.down_shape = systs.true_down_shape;
     }
 
     ConstantSystematic::ConstantSystematic(const YAML::Node& node) {
@@ -99,14 +110,8 @@ namespace plotIt {
         value = node["value"].as<float>();
     }
 
-    void ConstantSystematic::apply(SystematicSet& systs) {
-        Systematic::apply(systs);
-
-        TH1* up = static_cast<TH1*>(systs.up_shape.get());
-        TH1* down = static_cast<TH1*>(systs.down_shape.get());
-
-        up->Scale(value);
-        down->Scale(2 - value);
+    SystematicSet ConstantSystematic::newSet(const cow_ptr<TObject>& nominal, File& file, const Plot& plot) {
+        return newNormalisationSet(value, 2 - value);
     }
 
     LogNormalSystematic::LogNormalSystematic(const YAML::Node& node) {
@@ -136,14 +141,8 @@ namespace plotIt {
         eval();
     }
 
-    void LogNormalSystematic::apply(SystematicSet& systs) {
-        Systematic::apply(systs);
-
-        TH1* up = static_cast<TH1*>(systs.up_shape.get());
-        TH1* down = static_cast<TH1*>(systs.down_shape.get());
-
-        up->Scale(value_up);
-        down->Scale(value_down);
+    SystematicSet LogNormalSystematic::newSet(const cow_ptr<TObject>& nominal, File& file, const Plot& plot) {
+        return newNormalisationSet(value_up, value_down);
     }
 
     void LogNormalSystematic::eval() {
@@ -161,17 +160,27 @@ namespace plotIt {
 
     }
 
-    SystematicSet ShapeSystematic::newSet(TObject* nominal, File& file, const Plot& plot) {
+    SystematicSet ShapeSystematic::newSet(const cow_ptr<TObject>& nominal, File& file, const Plot& plot) {
+        Timing::Scope timing("ShapeSystematic::newSet", name);
 
         auto result = Systematic::newSet(nominal, file, plot);
 
-        // We need to find the up and down shape
-        // Two possibilities:
-        //   - we look for two objects named <nominal>__<systematic>[up|down] in the same file
-        //   - we look for two objects named <nominal> in the file <nominal>__<systematic>[up|down].root
+        std::shared_ptr<TObject> up = loadVariation(file, plot, UP);
+        if (up)
+            result.true_up_shape = up;
+
+        std::shared_ptr<TObject> down = loadVariation(file, plot, DOWN);
+        if (down)
+            result.true_down_shape = down;
 
-        std::array<Variation, 2> variations = {UP, DOWN};
-        std::map<Variation, std::shared_ptr<TObject>*> links = {{UP, &result.true_up_shape}, {DOWN, &result.true_down_shape}};
+        return result;
+    }
+
+    std::shared_ptr<TObject> ShapeSystematic::loadVariation(File& file, const Plot& plot, Variation variation) {
+
+        // Two possibilities:
+        //   - we look for an object named <nominal>__<systematic>[up|down] in the same file
+        //   - we look for an object named <nominal> in the file <nominal>__<systematic>[up|down].root
 
         auto formatSystematicsName = [this](Variation variation) {
             static std::map<Variation, std::string> names = {{UP, "up"}, {DOWN, "down"}};
@@ -183,61 +192,46 @@ namespace plotIt {
             return "__" + this->name + names[variation];
         };
 
-        for (const auto& variation: variations) {
-            std::string object_postfix = formatSystematicsName(variation);
+        std::string object_postfix = formatSystematicsName(variation);
 
-            TObject* object = NULL;
+        std::shared_ptr<TObject> object;
 
-            if (!CommandLineCfg::get().desytop) {
+        if (!CommandLineCfg::get().desytop) {
 
-                std::string object_name = applyRenaming(file.renaming_ops, plot.name) + object_postfix;
-                object = file.handle->Get(object_name.c_str());
+            std::string object_name = getObjectName(file, plot.name) + object_postfix;
+            // Missing if the file cannot be opened, which is already reported
+            if (! getCachedObject(file.path, file.handle, file.keys, object_name, object))
+                return object;
 
-                if (!object) {
-                    std::string object_postfix2 = formatSystematicsName2(variation);
-                    std::string object_name2 = applyRenaming(file.renaming_ops, plot.name) + object_postfix2;
-                    object = file.handle->Get(object_name2.c_str());
-                }
-
-                if (object) {
-                    links[variation]->reset(object->Clone());
-                    continue;
-                }
+            if (!object) {
+                std::string object_postfix2 = formatSystematicsName2(variation);
+                std::string object_name2 = getObjectName(file, plot.name) + object_postfix2;
+                getCachedObject(file.path, file.handle, file.keys, object_name2, object);
             }
 
-            auto nominal_path = fs::path(file.path);
-            auto syst_path = nominal_path.parent_path();
-            syst_path /= nominal_path.stem();
-            syst_path += object_postfix;
-            syst_path += ".root";
-
-            if (fs::exists(syst_path)) {
-                std::shared_ptr<TFile>& f = file.friend_handles[syst_path.native()];
-                if (! f)
-                    f.reset(TFile::Open(syst_path.native().c_str()));
-
-                if (ext_sum_weight_up > 1.1 and ext_sum_weight_down > 1.1){
-                    if(variation == UP) {
-                        TH1F* tmp = (TH1F*) f->Get(plot.name.c_str());
-                        tmp->Scale(file.generated_events / ext_sum_weight_up);
-                        object = tmp;
-                    }
-                    else if (variation == DOWN) {
-                        TH1F* tmp = (TH1F*) f->Get(plot.name.c_str());
-                        tmp->Scale(file.generated_events / ext_sum_weight_down);
-                        object = tmp;
-                    }
-                }
-
-                else object = f->Get(plot.name.c_str());
-
-                if (object) {
-                    links[variation]->reset(object->Clone());
-                }
+            if (object)
+                return object;
+        }
+
+        auto nominal_path = fs::path(file.path);
+        auto syst_path = nominal_path.parent_path();
+        syst_path /= nominal_path.stem();
+        syst_path += object_postfix;
+        syst_path += ".root";
+
+        if (fs::exists(syst_path)) {
+            std::shared_ptr<TFile>& f = file.friend_handles[syst_path.native()];
+            std::shared_ptr<KeyIndex>& keys = file.friend_keys[syst_path.native()];
+
+            getCachedObject(syst_path.native(), f, keys, plot.name, object);
+
+            if (object && ext_sum_weight_up > 1.1 and ext_sum_weight_down > 1.1) {
+                float ext_sum_weight = (variation == UP) ? ext_sum_weight_up : ext_sum_weight_down;
+                static_cast<TH1*>(object.get())->Scale(file.generated_events / ext_sum_weight);
             }
         }
 
-        return result;
+        return object;
     }
 
 
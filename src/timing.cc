@@ -0,0 +1,275 @@
+#include <timing.h>
+
+#include <ipc.h>
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <unistd.h>
+
+namespace plotIt {
+
+    namespace {
+        std::string escape(const std::string& value) {
+            std::string result;
+            result.reserve(value.size());
+
+            for (char c: value) {
+                if (c == '"' || c == '\\') {
+                    result += '\\';
+                    result += c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    result += buffer;
+                } else {
+                    result += c;
+                }
+            }
+
+            return result;
+        }
+    }
+
+    Timing::Timing() {
+        reset();
+    }
+
+    const char* Timing::name(Phase phase) {
+        switch (phase) {
+            case PARSE:
+                return "parse";
+            case LOAD:
+                return "load";
+            case SYSTEMATICS:
+                return "systematics";
+            case STACK:
+                return "stack";
+            case DRAW:
+                return "draw";
+            case SAVE:
+                return "save";
+            case YIELDS:
+                return "yields";
+            default:
+                break;
+        }
+
+        return "unknown";
+    }
+
+    void Timing::enableTrace(const std::string& path) {
+        m_trace_path = path;
+        m_trace_origin = std::chrono::duration_cast<std::chrono::microseconds>(clock::now().time_since_epoch()).count();
+    }
+
+    void Timing::reset(const std::string& process_name) {
+        for (std::size_t i = 0; i < N_PHASES; i++) {
+            m_seconds[i] = 0;
+            m_calls[i] = 0;
+        }
+
+        m_since = clock::now();
+
+        m_events.clear();
+        m_other_events.clear();
+        if (! process_name.empty())
+            m_process_name = process_name;
+    }
+
+    // The seconds and calls of each phase, one line per phase, then the trace events, one per line
+    void Timing::write(std::ostream& out) const {
+        out << std::setprecision(9);
+        for (std::size_t i = 0; i < N_PHASES; i++)
+            out << m_seconds[i] << " " << m_calls[i] << std::endl;
+
+        if (tracing()) {
+            writeEvents(out, "\n");
+            out << std::endl;
+        }
+    }
+
+    bool Timing::read(std::istream& in) {
+        double seconds[N_PHASES];
+        std::size_t calls[N_PHASES];
+
+        for (std::size_t i = 0; i < N_PHASES; i++) {
+            if (! (in >> seconds[i] >> calls[i]))
+                return false;
+        }
+
+        for (std::size_t i = 0; i < N_PHASES; i++) {
+            m_seconds[i] += seconds[i];
+            m_calls[i] += calls[i];
+        }
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (! line.empty())
+                m_other_events.push_back(line);
+        }
+
+        return true;
+    }
+
+    bool Timing::write(int fd) const {
+        std::stringstream out;
+        write(out);
+
+        return writeString(fd, out.str());
+    }
+
+    bool Timing::read(int fd) {
+        std::string measurements;
+        if (! readString(fd, measurements))
+            return false;
+
+        std::istringstream in(measurements);
+        return read(in);
+    }
+
+    bool Timing::writeReport(const std::string& path) const {
+        std::ofstream out(path);
+        if (! out) {
+            std::cerr << "Error: cannot write timing report to '" << path << "'" << std::endl;
+            return false;
+        }
+
+        double total = std::chrono::duration<double>(clock::now() - m_start).count();
+
+        out << std::setprecision(6) << std::fixed;
+        out << "{" << std::endl;
+        out << "  \"total\": " << total << "," << std::endl;
+        out << "  \"phases\": {" << std::endl;
+        for (std::size_t i = 0; i < N_PHASES; i++) {
+            out << "    \"" << name(static_cast<Phase>(i)) << "\": {\"seconds\": " << m_seconds[i] << ", \"calls\": " << m_calls[i] << "}";
+            out << ((i + 1 < N_PHASES) ? "," : "") << std::endl;
+        }
+        out << "  }" << std::endl;
+        out << "}" << std::endl;
+
+        return true;
+    }
+
+    bool Timing::writeTrace() const {
+        if (! tracing())
+            return true;
+
+        std::ofstream out(m_trace_path);
+        if (! out) {
+            std::cerr << "Error: cannot write trace to '" << m_trace_path << "'" << std::endl;
+            return false;
+        }
+
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl;
+
+        writeEvents(out, ",\n");
+
+        out << std::endl << "]}" << std::endl;
+
+        return true;
+    }
+
+    void Timing::writeEvents(std::ostream& out, const char* separator) const {
+        int pid = getpid();
+
+        out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << pid
+            << ", \"args\": {\"name\": \"" << escape(m_process_name) << "\"}}";
+
+        for (const auto& event: m_events) {
+            out << separator;
+            out << "{\"name\": \"" << event.name << "\", \"cat\": \"plotIt\", \"ph\": \"X\", \"pid\": " << pid << ", \"tid\": " << pid
+                << ", \"ts\": " << event.start << ", \"dur\": " << event.duration
+                << ", \"tts\": " << event.cpu_start << ", \"tdur\": " << event.cpu_duration;
+            if (! event.detail.empty())
+                out << ", \"args\": {\"detail\": \"" << escape(event.detail) << "\"}";
+            out << "}";
+        }
+
+        // Events read from the other processes are written with those of this process
+        for (const auto& event: m_other_events)
+            out << separator << event;
+    }
+
+    int64_t Timing::traceNow() const {
+        // The steady clock is the same for all the processes
+        auto since_epoch = clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::microseconds>(since_epoch).count() - m_trace_origin;
+    }
+
+    int64_t Timing::cpuNow() {
+        timespec t;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) != 0)
+            return 0;
+
+        return static_cast<int64_t>(t.tv_sec) * 1000000 + t.tv_nsec / 1000;
+    }
+
+    void Timing::accumulate(clock::time_point now) {
+        if (! m_phases.empty())
+            m_seconds[m_phases.back()] += std::chrono::duration<double>(now - m_since).count();
+
+        m_since = now;
+    }
+
+    void Timing::begin(Phase phase) {
+        accumulate(clock::now());
+
+        m_phases.push_back(phase);
+        m_calls[phase]++;
+    }
+
+    void Timing::end() {
+        accumulate(clock::now());
+
+        m_phases.pop_back();
+    }
+
+    Timing::Scope::Scope(Phase phase, const char* name, const std::string& detail):
+        Scope(name ? name : Timing::name(phase), detail) {
+
+        m_timed = Timing::get().enabled() || Timing::get().tracing();
+        m_active |= m_timed;
+
+        if (m_timed)
+            Timing::get().begin(phase);
+    }
+
+    Timing::Scope::Scope(const char* name, const std::string& detail):
+        m_active(Timing::get().tracing()), m_timed(false), m_name(name), m_start(0), m_cpu_start(0) {
+
+        if (! Timing::get().tracing())
+            return;
+
+        m_detail = detail;
+        m_start = Timing::get().traceNow();
+        m_cpu_start = cpuNow();
+    }
+
+    Timing::Scope::~Scope() {
+        if (! m_active)
+            return;
+
+        Timing& timing = Timing::get();
+
+        if (m_timed)
+            timing.end();
+
+        if (! timing.tracing())
+            return;
+
+        Event event;
+        event.name = m_name;
+        event.detail = std::move(m_detail);
+        event.start = m_start;
+        event.duration = timing.traceNow() - m_start;
+        event.cpu_start = m_cpu_start;
+        event.cpu_duration = cpuNow() - m_cpu_start;
+
+        timing.m_events.push_back(std::move(event));
+    }
+}
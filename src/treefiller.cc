@@ -0,0 +1,196 @@
+#include <treefiller.h>
+
+#include <TChain.h>
+#include <TH1.h>
+#include <TTreeFormula.h>
+#include <TTreeFormulaManager.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace plotIt {
+
+    constexpr long long TreeFiller::entries_per_block;
+
+    /**
+     * Chain and formulas used by a single thread
+     */
+    class TreeFiller::Worker {
+        public:
+            bool init(const std::string& tree_name, const std::string& path, const std::vector<Booking>& bookings) {
+                m_chain.reset(new TChain(tree_name.c_str()));
+                m_chain->Add(path.c_str());
+
+                for (const auto& booking: bookings) {
+                    Formulas formulas;
+
+                    formulas.draw.reset(new TTreeFormula("draw", booking.draw.c_str(), m_chain.get()));
+                    if (formulas.draw->GetNdim() == 0) {
+                        std::cerr << "Error: invalid draw expression '" << booking.draw << "'" << std::endl;
+                        return false;
+                    }
+
+                    if (! booking.selection.empty()) {
+                        formulas.selection.reset(new TTreeFormula("selection", booking.selection.c_str(), m_chain.get()));
+                        if (formulas.selection->GetNdim() == 0) {
+                            std::cerr << "Error: invalid selection '" << booking.selection << "'" << std::endl;
+                            return false;
+                        }
+                    }
+
+                    // Keep the draw and selection expressions in sync when they involve arrays
+                    formulas.manager = new TTreeFormulaManager();
+                    formulas.manager->Add(formulas.draw.get());
+                    if (formulas.selection)
+                        formulas.manager->Add(formulas.selection.get());
+                    formulas.manager->Sync();
+
+                    // Like TTree::Draw, store the sum of squares of weights if the selection is a weight
+                    if (formulas.selection && ! formulas.selection->IsInteger() && booking.hist->GetSumw2N() == 0)
+                        booking.hist->Sumw2();
+
+                    m_formulas.push_back(std::move(formulas));
+                }
+
+                return true;
+            }
+
+            long long entries() {
+                return m_chain->GetEntries();
+            }
+
+            /**
+             * Evaluate the entries [first, last), calling `sink(booking, value, weight)` for each
+             * fill of each booked histogram, in the same order as TTree::Draw
+             */
+            template<typename Sink>
+            void fill(long long first, long long last, Sink sink) {
+                for (long long entry = first; entry < last; entry++) {
+                    if (m_chain->LoadTree(entry) < 0)
+                        break;
+
+                    // The chain moved to a new file: leaves must be looked up again
+                    if (m_chain->GetTreeNumber() != m_tree_number) {
+                        m_tree_number = m_chain->GetTreeNumber();
+                        m_weight = m_chain->GetWeight();
+
+                        for (auto& formulas: m_formulas)
+                            formulas.manager->UpdateFormulaLeaves();
+                    }
+
+                    for (std::size_t i = 0; i < m_formulas.size(); i++) {
+                        Formulas& formulas = m_formulas[i];
+
+                        int ndata = formulas.manager->GetNdata();
+
+                        for (int j = 0; j < ndata; j++) {
+                            double w = m_weight;
+                            if (formulas.selection) {
+                                w *= formulas.selection->EvalInstance(j);
+                                if (w == 0)
+                                    continue;
+                            }
+
+                            sink(i, formulas.draw->EvalInstance(j), w);
+                        }
+                    }
+                }
+            }
+
+        private:
+            struct Formulas {
+                std::unique_ptr<TTreeFormula> draw;
+                std::unique_ptr<TTreeFormula> selection;
+
+                // Owned by the formulas
+                TTreeFormulaManager* manager = nullptr;
+            };
+
+            std::unique_ptr<TChain> m_chain;
+            std::vector<Formulas> m_formulas;
+
+            int m_tree_number = -1;
+            double m_weight = 1;
+    };
+
+    TreeFiller::TreeFiller(const std::string& tree_name, const std::string& path):
+        m_tree_name(tree_name), m_path(path) {
+
+    }
+
+    TreeFiller::~TreeFiller() = default;
+
+    void TreeFiller::book(TH1* hist, const std::string& draw, const std::string& selection) {
+        m_bookings.push_back({hist, draw, selection});
+    }
+
+    bool TreeFiller::fill(unsigned int threads/* = 1*/) {
+        threads = std::max(threads, 1u);
+
+        // Formulas are all created upfront by this thread
+        std::vector<std::unique_ptr<Worker>> workers;
+        for (unsigned int i = 0; i < threads; i++) {
+            workers.emplace_back(new Worker());
+            if (! workers.back()->init(m_tree_name, m_path, m_bookings))
+                return false;
+        }
+
+        long long entries = workers.front()->entries();
+
+        // A single thread fills the histograms directly
+        if (threads == 1) {
+            workers.front()->fill(0, entries, [this](std::size_t booking, double value, double weight) {
+                    m_bookings[booking].hist->Fill(value, weight);
+                });
+
+            return true;
+        }
+
+        long long n_blocks = (entries + entries_per_block - 1) / entries_per_block;
+
+        std::atomic<long long> next_block(0);
+        std::mutex mutex;
+        long long next_merged_block = 0;
+        std::map<long long, Fills> pending_blocks;
+
+        auto run = [&](Worker* worker) {
+            long long block;
+            while ((block = next_block++) < n_blocks) {
+                Fills fills(m_bookings.size());
+
+                long long first = block * entries_per_block;
+                worker->fill(first, std::min(first + entries_per_block, entries), [&fills](std::size_t booking, double value, double weight) {
+                        fills[booking].emplace_back(value, weight);
+                    });
+
+                std::lock_guard<std::mutex> lock(mutex);
+                pending_blocks[block] = std::move(fills);
+
+                // Replay the blocks in order, whichever thread filled them
+                auto it = pending_blocks.find(next_merged_block);
+                while (it != pending_blocks.end()) {
+                    for (std::size_t i = 0; i < m_bookings.size(); i++) {
+                        for (const auto& fill: it->second[i])
+                            m_bookings[i].hist->Fill(fill.first, fill.second);
+                    }
+
+                    pending_blocks.erase(it);
+                    it = pending_blocks.find(++next_merged_block);
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (auto& worker: workers)
+            pool.emplace_back(run, worker.get());
+
+        for (auto& thread: pool)
+            thread.join();
+
+        return true;
+    }
+}
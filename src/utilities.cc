@@ -6,9 +6,17 @@
 
 #include <TH1.h>
 #include <THStack.h>
+#include <TKey.h>
 #include <TStyle.h>
 #include <TColor.h>
 
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include <sys/stat.h>
+
 namespace plotIt {
 
   TStyle* createStyle(const Configuration& config) {
@@ -251,13 +259,181 @@ namespace plotIt {
       return local_root;
   }
 
+  namespace {
+      void indexKeys(TDirectory* root, const std::string& prefix, KeyIndex& index) {
+          TIter it(root->GetListOfKeys());
+          TKey* key = nullptr;
+
+          while ((key = static_cast<TKey*>(it()))) {
+              std::string name = prefix + key->GetName();
+              std::string cl = key->GetClassName();
+
+              TKey*& entry = index[name];
+              if (entry && entry->GetCycle() >= key->GetCycle())
+                  continue;
+
+              entry = key;
+
+              if (cl.find("TDirectory") != std::string::npos) {
+                  indexKeys(static_cast<TDirectory*>(key->ReadObj()), name + "/", index);
+              }
+          }
+      }
+  }
+
+  std::shared_ptr<KeyIndex> indexKeys(TDirectory* root) {
+      std::shared_ptr<KeyIndex> index = std::make_shared<KeyIndex>();
+      indexKeys(root, "", *index);
+
+      return index;
+  }
+
+  bool openRootFile(const std::string& path, std::shared_ptr<TFile>& handle, std::shared_ptr<KeyIndex>& keys) {
+      if (! handle) {
+          handle.reset(TFile::Open(path.c_str()));
+          if (! handle)
+              return false;
+
+          keys = indexKeys(handle.get());
+      }
+
+      return true;
+  }
+
+  std::shared_ptr<TObject> getObject(const KeyIndex& keys, const std::string& name) {
+      auto it = keys.find(name);
+      if (it == keys.end())
+          return std::shared_ptr<TObject>();
+
+      std::shared_ptr<TObject> object(it->second->ReadObj());
+      if (TH1* h = dynamic_cast<TH1*>(object.get()))
+          h->SetDirectory(nullptr);
+
+      return object;
+  }
+
+  void copyObjects(TDirectory* from, TDirectory* to) {
+      TIter it(from->GetListOfKeys());
+      TKey* key = nullptr;
+
+      // The keys list every cycle of an object: copy only the highest one, once
+      std::set<std::string> copied;
+
+      while ((key = static_cast<TKey*>(it()))) {
+          if (! copied.insert(key->GetName()).second)
+              continue;
+
+          key = from->GetKey(key->GetName());
+          std::string cl = key->GetClassName();
+
+          if (cl.find("TDirectory") != std::string::npos) {
+              TDirectory* dir = to->GetDirectory(key->GetName());
+              if (! dir)
+                  dir = to->mkdir(key->GetName());
+
+              copyObjects(static_cast<TDirectory*>(key->ReadObj()), dir);
+              continue;
+          }
+
+          std::unique_ptr<TObject> object(key->ReadObj());
+          to->WriteTObject(object.get(), key->GetName(), "Overwrite");
+      }
+  }
+
+  std::string hashString(const std::string& value) {
+      uint64_t h = 14695981039346656037ULL;
+      for (unsigned char c: value) {
+          h ^= c;
+          h *= 1099511628211ULL;
+      }
+
+      char buffer[17];
+      std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(h));
+
+      return buffer;
+  }
+
+  std::string fileIdentity(const std::string& path) {
+      fs::path absolute = fs::absolute(path);
+
+      // Nanosecond modification and change times, and the inode: a file rewritten within the
+      // same second, with the same size, still gets a new identity
+      struct stat st;
+      if (::stat(absolute.c_str(), &st) != 0)
+          return std::string();
+
+      std::stringstream identity;
+      identity << absolute.string() << "|" << st.st_dev << ":" << st.st_ino
+          << "|" << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec
+          << "|" << st.st_ctim.tv_sec << "." << st.st_ctim.tv_nsec
+          << "|" << st.st_size;
+
+      return identity.str();
+  }
+
+  std::size_t getPeakMemory() {
+      std::ifstream status("/proc/self/status");
+
+      std::string line;
+      while (std::getline(status, line)) {
+          if (line.compare(0, 6, "VmHWM:") == 0)
+              return std::stoull(line.substr(6)) * 1024;
+      }
+
+      return 0;
+  }
+
+  void resetPeakMemory() {
+      // Reset the peak to the current resident memory (Linux >= 4.0)
+      std::ofstream clear_refs("/proc/self/clear_refs");
+      clear_refs << "5" << std::endl;
+  }
+
+  RenameOp makeRenameOp(const std::string& from, const std::string& to) {
+      RenameOp op;
+      op.to = to;
+
+      // No special character in the pattern, and no reference to the match in the replacement
+      op.literal = ! from.empty() &&
+          from.find_first_of(R"(.[]()*+?{}|^$\)") == std::string::npos &&
+          to.find_first_of(R"(&\)") == std::string::npos;
+
+      if (op.literal)
+          op.literal_from = from;
+      else
+          op.from = std::regex(from, std::regex::extended);
+
+      return op;
+  }
+
   std::string applyRenaming(const std::vector<RenameOp>& ops, const std::string input) {
       std::string result = input;
 
       for (const auto& op: ops) {
-          result = std::regex_replace(result, op.from, op.to, std::regex_constants::format_sed);
+          if (! op.literal) {
+              result = std::regex_replace(result, op.from, op.to, std::regex_constants::format_sed);
+              continue;
+          }
+
+          // Same as regex_replace: all the occurrences, from left to right
+          std::size_t pos = 0;
+          while ((pos = result.find(op.literal_from, pos)) != std::string::npos) {
+              result.replace(pos, op.literal_from.size(), op.to);
+              pos += op.to.size();
+          }
       }
 
       return result;
   }
+
+  const std::string& getObjectName(File& file, const std::string& plot_name) {
+      if (file.renaming_ops.empty())
+          return plot_name;
+
+      auto it = file.renamed_objects.find(plot_name);
+      if (it == file.renamed_objects.end())
+          it = file.renamed_objects.insert(std::make_pair(plot_name, applyRenaming(file.renaming_ops, plot_name))).first;
+
+      return it->second;
+  }
 }
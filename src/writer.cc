@@ -0,0 +1,164 @@
+#include <writer.h>
+
+#include <ipc.h>
+#include <timing.h>
+
+#include <TBufferFile.h>
+#include <TCanvas.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace fs = boost::filesystem;
+
+namespace plotIt {
+
+    constexpr std::size_t CanvasWriter::queue_size;
+
+    namespace {
+        /**
+         * A canvas waiting to be written: the list of output files, followed by the serialized canvas
+         */
+        struct Message {
+            std::vector<std::string> outputs;
+            std::vector<char> canvas;
+        };
+
+        bool read_message(int fd, Message& message) {
+            uint32_t n_outputs = 0;
+            if (! readAll(fd, &n_outputs, sizeof(n_outputs)))
+                return false;
+
+            message.outputs.resize(n_outputs);
+            for (auto& output: message.outputs) {
+                if (! readString(fd, output))
+                    return false;
+            }
+
+            uint64_t size = 0;
+            if (! readAll(fd, &size, sizeof(size)))
+                return false;
+
+            message.canvas.resize(size);
+            return size == 0 || readAll(fd, message.canvas.data(), size);
+        }
+    }
+
+    CanvasWriter::~CanvasWriter() {
+        finish();
+    }
+
+    bool CanvasWriter::start() {
+        if (m_process.running())
+            return true;
+
+        if (! m_process.start("writer", [this](int fd) { run(fd); return ! m_failed; })) {
+            std::cerr << "Error: cannot start writer process: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    bool CanvasWriter::save(TCanvas& canvas, const std::vector<fs::path>& outputs) {
+        if (m_process.running()) {
+            int fd = m_process.fd();
+
+            TBufferFile buffer(TBufferFile::kWrite);
+            buffer.WriteObject(&canvas);
+
+            bool success = true;
+
+            uint32_t n_outputs = outputs.size();
+            success &= writeAll(fd, &n_outputs, sizeof(n_outputs));
+            for (const auto& output: outputs)
+                success &= writeString(fd, output.native());
+
+            uint64_t size = buffer.Length();
+            success &= writeAll(fd, &size, sizeof(size));
+            success &= writeAll(fd, buffer.Buffer(), size);
+
+            if (success)
+                return true;
+
+            std::cerr << "Error: the writer process is gone, saving the remaining plots directly" << std::endl;
+            finish();
+        }
+
+        for (const auto& output: outputs) {
+            Timing::Scope timing("SaveAs", output.native());
+            canvas.SaveAs(output.c_str());
+        }
+
+        return true;
+    }
+
+    bool CanvasWriter::finish() {
+        return m_process.finish();
+    }
+
+    // Body of the writer process. A thread receives the canvases while the previous ones are being written
+    void CanvasWriter::run(int fd) {
+        std::deque<Message> queue;
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        bool done = false;
+
+        std::thread reader([&]() {
+            while (true) {
+                Message message;
+                bool success = read_message(fd, message);
+
+                std::unique_lock<std::mutex> lock(mutex);
+                if (! success) {
+                    done = true;
+                    not_empty.notify_one();
+                    return;
+                }
+
+                not_full.wait(lock, [&]() { return queue.size() < queue_size; });
+                queue.push_back(std::move(message));
+                not_empty.notify_one();
+            }
+        });
+
+        while (true) {
+            Message message;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_empty.wait(lock, [&]() { return done || ! queue.empty(); });
+                if (queue.empty())
+                    break;
+
+                message = std::move(queue.front());
+                queue.pop_front();
+                not_full.notify_one();
+            }
+
+            TBufferFile buffer(TBufferFile::kRead, message.canvas.size(), message.canvas.data(), false);
+            std::unique_ptr<TCanvas> canvas(static_cast<TCanvas*>(buffer.ReadObject(TCanvas::Class())));
+            if (! canvas) {
+                std::cerr << "Error: cannot read a canvas sent by the plotting process" << std::endl;
+                m_failed = true;
+                continue;
+            }
+
+            for (const auto& output: message.outputs) {
+                Timing::Scope timing("SaveAs", output);
+                canvas->SaveAs(output.c_str());
+            }
+        }
+
+        reader.join();
+    }
+}
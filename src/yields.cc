@@ -0,0 +1,268 @@
+#include <yields.h>
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+namespace plotIt {
+
+    namespace {
+        // Minimal binary encoding: fixed-size values are stored as-is, strings and containers are length-prefixed
+        void write_value(std::ostream& out, const std::string& value);
+        bool read_value(std::istream& in, std::string& value);
+        void write_value(std::ostream& out, const YieldsTable::ProcessKey& value);
+        bool read_value(std::istream& in, YieldsTable::ProcessKey& value);
+        template<typename T1, typename T2> void write_value(std::ostream& out, const std::pair<T1, T2>& value);
+        template<typename T1, typename T2> bool read_value(std::istream& in, std::pair<T1, T2>& value);
+        template<typename K, typename V> void write_value(std::ostream& out, const std::map<K, V>& value);
+        template<typename K, typename V> bool read_value(std::istream& in, std::map<K, V>& value);
+        template<typename T> void write_value(std::ostream& out, const std::set<T>& value);
+        template<typename T> bool read_value(std::istream& in, std::set<T>& value);
+        template<typename T> void write_value(std::ostream& out, const std::vector<T>& value);
+        template<typename T> bool read_value(std::istream& in, std::vector<T>& value);
+
+        template<typename T>
+        void write_value(std::ostream& out, const T& value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template<typename T>
+        bool read_value(std::istream& in, T& value) {
+            return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+        }
+
+        void write_value(std::ostream& out, const std::string& value) {
+            write_value(out, static_cast<uint64_t>(value.size()));
+            out.write(value.data(), value.size());
+        }
+
+        bool read_value(std::istream& in, std::string& value) {
+            uint64_t size = 0;
+            if (!read_value(in, size))
+                return false;
+
+            value.resize(size);
+            return size == 0 || static_cast<bool>(in.read(&value[0], size));
+        }
+
+        template<typename T1, typename T2>
+        void write_value(std::ostream& out, const std::pair<T1, T2>& value) {
+            write_value(out, value.first);
+            write_value(out, value.second);
+        }
+
+        template<typename T1, typename T2>
+        bool read_value(std::istream& in, std::pair<T1, T2>& value) {
+            return read_value(in, value.first) && read_value(in, value.second);
+        }
+
+        void write_value(std::ostream& out, const YieldsTable::ProcessKey& value) {
+            write_value(out, std::get<0>(value));
+            write_value(out, std::get<1>(value));
+            write_value(out, std::get<2>(value));
+        }
+
+        bool read_value(std::istream& in, YieldsTable::ProcessKey& value) {
+            return read_value(in, std::get<0>(value)) && read_value(in, std::get<1>(value)) && read_value(in, std::get<2>(value));
+        }
+
+        template<typename K, typename V>
+        void write_value(std::ostream& out, const std::map<K, V>& value) {
+            write_value(out, static_cast<uint64_t>(value.size()));
+            for (const auto& it: value)
+                write_value(out, it);
+        }
+
+        template<typename K, typename V>
+        bool read_value(std::istream& in, std::map<K, V>& value) {
+            uint64_t size = 0;
+            if (!read_value(in, size))
+                return false;
+
+            value.clear();
+            for (uint64_t i = 0; i < size; i++) {
+                std::pair<K, V> item;
+                if (!read_value(in, item))
+                    return false;
+                value.emplace(std::move(item));
+            }
+
+            return true;
+        }
+
+        template<typename T>
+        void write_value(std::ostream& out, const std::set<T>& value) {
+            write_value(out, static_cast<uint64_t>(value.size()));
+            for (const auto& it: value)
+                write_value(out, it);
+        }
+
+        template<typename T>
+        bool read_value(std::istream& in, std::set<T>& value) {
+            uint64_t size = 0;
+            if (!read_value(in, size))
+                return false;
+
+            value.clear();
+            for (uint64_t i = 0; i < size; i++) {
+                T item;
+                if (!read_value(in, item))
+                    return false;
+                value.emplace(std::move(item));
+            }
+
+            return true;
+        }
+
+        template<typename T>
+        void write_value(std::ostream& out, const std::vector<T>& value) {
+            write_value(out, static_cast<uint64_t>(value.size()));
+            for (const auto& it: value)
+                write_value(out, it);
+        }
+
+        template<typename T>
+        bool read_value(std::istream& in, std::vector<T>& value) {
+            uint64_t size = 0;
+            if (!read_value(in, size))
+                return false;
+
+            value.resize(size);
+            for (auto& it: value) {
+                if (!read_value(in, it))
+                    return false;
+            }
+
+            return true;
+        }
+
+        // Copy the entries of `from` whose category is in `categories` into `to`
+        template<typename V>
+        void merge_categories(std::map<std::string, V>& to, const std::map<std::string, V>& from, const std::set<std::string>& categories) {
+            for (const auto& it: from) {
+                if (categories.count(it.first))
+                    to[it.first] = it.second;
+            }
+        }
+
+        void merge_categories(std::map<YieldsTable::ProcessKey, double>& to, const std::map<YieldsTable::ProcessKey, double>& from, const std::set<std::string>& categories) {
+            for (const auto& it: from) {
+                if (categories.count(std::get<1>(it.first)))
+                    to[it.first] = it.second;
+            }
+        }
+
+        // Remove the entries of `from` whose category is in `categories`
+        template<typename V>
+        void erase_categories(std::map<std::string, V>& from, const std::set<std::string>& categories) {
+            for (const auto& category: categories)
+                from.erase(category);
+        }
+
+        void erase_categories(std::map<YieldsTable::ProcessKey, double>& from, const std::set<std::string>& categories) {
+            for (auto it = from.begin(); it != from.end();) {
+                if (categories.count(std::get<1>(it->first)))
+                    it = from.erase(it);
+                else
+                    ++it;
+            }
+        }
+    }
+
+    bool YieldsTable::hasCategory(const std::string& category) const {
+        return std::find_if(categories.begin(), categories.end(), [&category](const std::pair<int, std::string>& x) { return x.second == category; }) != categories.end();
+    }
+
+    void YieldsTable::merge(const YieldsTable& other) {
+        std::set<std::string> new_categories;
+        std::set<std::string> replaced_categories;
+        for (const auto& category: other.categories) {
+            uint64_t position = other.category_positions.at(category.second);
+
+            auto it = category_positions.find(category.second);
+            if (it != category_positions.end()) {
+                if (it->second <= position)
+                    continue;
+
+                // Filled by a later plot here: take the one of the other table
+                replaced_categories.emplace(category.second);
+                categories.erase(std::find_if(categories.begin(), categories.end(), [&category](const std::pair<int, std::string>& x) { return x.second == category.second; }));
+            }
+
+            categories.push_back(category);
+            category_positions[category.second] = position;
+            new_categories.emplace(category.second);
+        }
+
+        erase_categories(data_yields, replaced_categories);
+        erase_categories(mc_yields, replaced_categories);
+        erase_categories(mc_total, replaced_categories);
+        erase_categories(mc_total_sqerrs, replaced_categories);
+        erase_categories(signal_yields, replaced_categories);
+        erase_categories(process_systematics, replaced_categories);
+        erase_categories(process_systematics_up, replaced_categories);
+        erase_categories(process_systematics_dn, replaced_categories);
+        erase_categories(total_systematics_squared, replaced_categories);
+        erase_categories(total_systematics_squared_up, replaced_categories);
+        erase_categories(total_systematics_squared_dn, replaced_categories);
+
+        merge_categories(data_yields, other.data_yields, new_categories);
+        merge_categories(mc_yields, other.mc_yields, new_categories);
+        merge_categories(mc_total, other.mc_total, new_categories);
+        merge_categories(mc_total_sqerrs, other.mc_total_sqerrs, new_categories);
+        merge_categories(signal_yields, other.signal_yields, new_categories);
+        merge_categories(process_systematics, other.process_systematics, new_categories);
+        merge_categories(process_systematics_up, other.process_systematics_up, new_categories);
+        merge_categories(process_systematics_dn, other.process_systematics_dn, new_categories);
+        merge_categories(total_systematics_squared, other.total_systematics_squared, new_categories);
+        merge_categories(total_systematics_squared_up, other.total_systematics_squared_up, new_categories);
+        merge_categories(total_systematics_squared_dn, other.total_systematics_squared_dn, new_categories);
+
+        mc_processes.insert(other.mc_processes.begin(), other.mc_processes.end());
+        signal_processes.insert(other.signal_processes.begin(), other.signal_processes.end());
+
+        has_data |= other.has_data;
+
+        std::sort(categories.begin(), categories.end(), [this](const std::pair<int, std::string>& a, const std::pair<int, std::string>& b) {
+                return category_positions.at(a.second) < category_positions.at(b.second);
+            });
+    }
+
+    void YieldsTable::write(std::ostream& out) const {
+        write_value(out, data_yields);
+        write_value(out, mc_yields);
+        write_value(out, mc_total);
+        write_value(out, mc_total_sqerrs);
+        write_value(out, mc_processes);
+        write_value(out, signal_yields);
+        write_value(out, signal_processes);
+        write_value(out, process_systematics);
+        write_value(out, process_systematics_up);
+        write_value(out, process_systematics_dn);
+        write_value(out, total_systematics_squared);
+        write_value(out, total_systematics_squared_up);
+        write_value(out, total_systematics_squared_dn);
+        write_value(out, categories);
+        write_value(out, category_positions);
+        write_value(out, has_data);
+    }
+
+    bool YieldsTable::read(std::istream& in) {
+        return read_value(in, data_yields) &&
+            read_value(in, mc_yields) &&
+            read_value(in, mc_total) &&
+            read_value(in, mc_total_sqerrs) &&
+            read_value(in, mc_processes) &&
+            read_value(in, signal_yields) &&
+            read_value(in, signal_processes) &&
+            read_value(in, process_systematics) &&
+            read_value(in, process_systematics_up) &&
+            read_value(in, process_systematics_dn) &&
+            read_value(in, total_systematics_squared) &&
+            read_value(in, total_systematics_squared_up) &&
+            read_value(in, total_systematics_squared_dn) &&
+            read_value(in, categories) &&
+            read_value(in, category_positions) &&
+            read_value(in, has_data);
+    }
+}
@@ -0,0 +1,191 @@
+/**
+ * Check that filling histograms from a tree in a single pass gives exactly the same result
+ * as TTree::Draw, with one thread and with several: same content and same error in every
+ * bin, including the under- and overflow.
+ *
+ * The tree spans several blocks of TreeFiller::entries_per_block entries, the last one
+ * incomplete, and is read through a chain of two files with different tree weights.
+ *
+ * Usage: treefiller [work folder]
+ */
+
+#include <treefiller.h>
+
+#include <TChain.h>
+#include <TFile.h>
+#include <TH1F.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    const char* tree_name = "events";
+
+    bool write_tree(const std::string& path, long long entries, double weight, unsigned int seed) {
+        std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "recreate"));
+        if (! file) {
+            std::cerr << "Error: cannot create '" << path << "'" << std::endl;
+            return false;
+        }
+
+        std::mt19937 generator(seed);
+        std::normal_distribution<float> gauss(50, 20);
+        std::uniform_real_distribution<float> uniform(0, 2);
+        std::uniform_int_distribution<int> multiplicity(0, 4);
+
+        float x;
+        float w;
+        int n;
+        float values[4];
+
+        // Owned by the file
+        TTree* tree = new TTree(tree_name, "");
+        tree->Branch("x", &x, "x/F");
+        tree->Branch("w", &w, "w/F");
+        tree->Branch("n", &n, "n/I");
+        tree->Branch("values", values, "values[n]/F");
+        tree->SetWeight(weight);
+
+        for (long long entry = 0; entry < entries; entry++) {
+            x = gauss(generator);
+            w = uniform(generator);
+            n = multiplicity(generator);
+            for (int i = 0; i < n; i++)
+                values[i] = gauss(generator);
+
+            tree->Fill();
+        }
+
+        tree->Write();
+        file->Close();
+
+        return true;
+    }
+
+    struct Booking {
+        const char* name;
+        const char* draw;
+        const char* selection;
+    };
+
+    const std::vector<Booking> bookings = {
+        {"plain", "x", ""},
+        {"cut", "x", "x > 30"},
+        {"weighted", "x", "w * (x > 20)"},
+        {"array", "values", ""},
+        {"array_weighted", "values", "w"},
+    };
+
+    std::vector<std::unique_ptr<TH1>> fill(const std::string& path, unsigned int threads) {
+        std::vector<std::unique_ptr<TH1>> hists;
+        plotIt::TreeFiller filler(tree_name, path);
+
+        for (const auto& booking: bookings) {
+            std::string name = std::string(booking.name) + "_" + std::to_string(threads);
+            hists.emplace_back(new TH1F(name.c_str(), "", 60, 0, 100));
+            hists.back()->SetDirectory(nullptr);
+
+            filler.book(hists.back().get(), booking.draw, booking.selection);
+        }
+
+        if (! filler.fill(threads))
+            hists.clear();
+
+        return hists;
+    }
+
+    // The reference: one TTree::Draw per histogram, as tree mode did before the single pass
+    std::vector<std::unique_ptr<TH1>> draw(const std::string& path) {
+        std::vector<std::unique_ptr<TH1>> hists;
+
+        TChain chain(tree_name);
+        chain.Add(path.c_str());
+
+        for (const auto& booking: bookings) {
+            std::string name = std::string(booking.name) + "_draw";
+            hists.emplace_back(new TH1F(name.c_str(), "", 60, 0, 100));
+
+            // Found by name by TTree::Draw
+            hists.back()->SetDirectory(gROOT);
+            long long result = chain.Draw((std::string(booking.draw) + ">>" + name).c_str(), booking.selection, "goff");
+            hists.back()->SetDirectory(nullptr);
+
+            if (result < 0) {
+                hists.clear();
+                break;
+            }
+        }
+
+        return hists;
+    }
+
+    // Number of bins differing between `reference` and `hists`
+    std::size_t compare(const std::vector<std::unique_ptr<TH1>>& reference, const std::vector<std::unique_ptr<TH1>>& hists, const std::string& what) {
+        std::size_t failures = 0;
+        for (std::size_t i = 0; i < bookings.size(); i++) {
+            const TH1* a = reference[i].get();
+            const TH1* b = hists[i].get();
+
+            if (a->GetEntries() == 0) {
+                std::cerr << bookings[i].name << ": empty histogram" << std::endl;
+                failures++;
+            }
+
+            for (int bin = 0; bin <= a->GetNbinsX() + 1; bin++) {
+                // Exact comparison: the fills must be done in the same order
+                if (a->GetBinContent(bin) != b->GetBinContent(bin) || a->GetBinError(bin) != b->GetBinError(bin)) {
+                    std::cerr << bookings[i].name << ": bin " << bin << " differs: "
+                        << a->GetBinContent(bin) << " +- " << a->GetBinError(bin) << " with TTree::Draw, "
+                        << b->GetBinContent(bin) << " +- " << b->GetBinError(bin) << " " << what << std::endl;
+                    failures++;
+                }
+            }
+        }
+
+        return failures;
+    }
+}
+
+int main(int argc, char** argv) {
+
+    std::string folder = (argc > 1) ? argv[1] : ".";
+    std::string first = folder + "/treefiller_1.root";
+    std::string second = folder + "/treefiller_2.root";
+
+    // Several blocks, and a last incomplete one, in each file
+    long long block = plotIt::TreeFiller::entries_per_block;
+    if (! write_tree(first, 2 * block + block / 3, 1., 1) || ! write_tree(second, block + 7, 0.5, 2))
+        return 1;
+
+    ROOT::EnableThreadSafety();
+
+    std::string chain = folder + "/treefiller_*.root";
+    auto reference = draw(chain);
+    auto serial = fill(chain, 1);
+    auto threaded = fill(chain, 4);
+
+    std::remove(first.c_str());
+    std::remove(second.c_str());
+
+    if (reference.empty() || serial.empty() || threaded.empty()) {
+        std::cerr << "Error: cannot fill the histograms" << std::endl;
+        return 1;
+    }
+
+    std::size_t failures = compare(reference, serial, "with 1 thread") + compare(reference, threaded, "with 4 threads");
+    if (failures) {
+        std::cerr << failures << " differences with TTree::Draw" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Histograms filled with 1 and 4 threads are identical to TTree::Draw" << std::endl;
+
+    return 0;
+}